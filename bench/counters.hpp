@@ -0,0 +1,150 @@
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// ================= Allocation Accounting =================
+// global `operator new`/`delete` are replaced for the whole bench binary,
+// NOTE: include into a single translation unit only
+namespace alloc_stats {
+  inline std::atomic<size_t> allocations = 0;
+  inline std::atomic<size_t> bytes = 0;
+
+  // NOTE: kept out of line, GCC otherwise sees `free` of memory which the replaced `operator new` returned
+  //       and reports a mismatched deallocation (-Wmismatched-new-delete)
+  [[gnu::noinline]] inline void * allocate(size_t size, size_t alignment = 0) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+
+    size = size == 0 ? 1 : size;
+    void *ptr = nullptr;
+    if (alignment > alignof(std::max_align_t)) {
+#ifdef _WIN32
+      ptr = _aligned_malloc(size, alignment);
+#else
+      ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+    } else {
+      ptr = std::malloc(size);
+    }
+    return ptr;
+  }
+
+  [[gnu::noinline]] inline void deallocate(void *ptr, size_t alignment = 0) noexcept {
+#ifdef _WIN32
+    if (alignment > alignof(std::max_align_t)) {
+      _aligned_free(ptr);
+      return;
+    }
+#endif
+    (void)alignment;
+    std::free(ptr);
+  }
+}
+
+void * operator new(size_t size) {
+  if (void *ptr = alloc_stats::allocate(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+void * operator new[](size_t size) {
+  return operator new(size);
+}
+void * operator new(size_t size, std::align_val_t alignment) {
+  if (void *ptr = alloc_stats::allocate(size, static_cast<size_t>(alignment))) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+void * operator new[](size_t size, std::align_val_t alignment) {
+  return operator new(size, alignment);
+}
+void * operator new(size_t size, const std::nothrow_t &) noexcept {
+  return alloc_stats::allocate(size);
+}
+void * operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return alloc_stats::allocate(size);
+}
+
+void operator delete(void *ptr) noexcept {
+  alloc_stats::deallocate(ptr);
+}
+void operator delete[](void *ptr) noexcept {
+  alloc_stats::deallocate(ptr);
+}
+void operator delete(void *ptr, size_t) noexcept {
+  alloc_stats::deallocate(ptr);
+}
+void operator delete[](void *ptr, size_t) noexcept {
+  alloc_stats::deallocate(ptr);
+}
+void operator delete(void *ptr, std::align_val_t alignment) noexcept {
+  alloc_stats::deallocate(ptr, static_cast<size_t>(alignment));
+}
+void operator delete[](void *ptr, std::align_val_t alignment) noexcept {
+  alloc_stats::deallocate(ptr, static_cast<size_t>(alignment));
+}
+void operator delete(void *ptr, size_t, std::align_val_t alignment) noexcept {
+  alloc_stats::deallocate(ptr, static_cast<size_t>(alignment));
+}
+void operator delete[](void *ptr, size_t, std::align_val_t alignment) noexcept {
+  alloc_stats::deallocate(ptr, static_cast<size_t>(alignment));
+}
+
+// ================= Copy Accounting =================
+// payload of a given size which counts how often (and how many bytes of it) it is copied, moves are free
+struct Payload {
+  inline static std::atomic<size_t> copies = 0;
+  inline static std::atomic<size_t> copied_bytes = 0;
+
+  std::vector<std::byte> bytes;
+
+  Payload() = default;
+  explicit Payload(size_t size) : bytes(size) {}
+
+  Payload(const Payload &other) : bytes(other.bytes) {
+    count();
+  }
+  Payload & operator=(const Payload &other) {
+    bytes = other.bytes;
+    count();
+    return *this;
+  }
+
+  Payload(Payload &&) noexcept = default;
+  Payload & operator=(Payload &&) noexcept = default;
+
+private:
+  void count() {
+    copies.fetch_add(1, std::memory_order_relaxed);
+    copied_bytes.fetch_add(bytes.size(), std::memory_order_relaxed);
+  }
+};
+
+// reports allocations (and payload copies) per iteration of the benchmark it is created in,
+// counts everything allocated by the benchmark thread and by the workers meanwhile
+struct HeapCounters {
+  benchmark::State &state;
+  size_t allocations = alloc_stats::allocations.load(std::memory_order_relaxed);
+  size_t bytes = alloc_stats::bytes.load(std::memory_order_relaxed);
+  size_t copies = Payload::copies.load(std::memory_order_relaxed);
+  size_t copied_bytes = Payload::copied_bytes.load(std::memory_order_relaxed);
+
+  explicit HeapCounters(benchmark::State &state) : state(state) {}
+
+  HeapCounters(const HeapCounters &) = delete;
+  HeapCounters & operator=(const HeapCounters &) = delete;
+
+  ~HeapCounters() {
+    auto per_iteration = [this](size_t value) {
+      return benchmark::Counter(static_cast<double>(value), benchmark::Counter::kAvgIterations);
+    };
+    state.counters["allocs"] = per_iteration(alloc_stats::allocations.load(std::memory_order_relaxed) - allocations);
+    state.counters["alloc_bytes"] = per_iteration(alloc_stats::bytes.load(std::memory_order_relaxed) - bytes);
+    state.counters["copies"] = per_iteration(Payload::copies.load(std::memory_order_relaxed) - copies);
+    state.counters["copied_bytes"] = per_iteration(Payload::copied_bytes.load(std::memory_order_relaxed) - copied_bytes);
+  }
+};
@@ -1,7 +1,21 @@
 #include <benchmark/benchmark.h>
 #include <mr-contractor/contractor.hpp>
 #include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <numeric>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+#if __has_include(<execution>)
+#include <execution>
+#endif
 
+#include "counters.hpp"
 #include "maps.hpp"
 
 // ================= Platform-Neutral Timing =================
@@ -17,10 +31,13 @@ constexpr size_t kMaxThreads = 32;
 inline static TaskMap nested_task_map = create_nested_task_map();
 // for measuring overhead of number of stages inside a task (no nested tasks)
 inline static TaskMap flat_task_map = create_flat_task_map();
+// same as `flat_task_map`, but prototypes are composed at runtime
+inline static TaskMap dynamic_task_map = create_dynamic_task_map();
 
 void BM_NestedTasks(benchmark::State& state) {
   auto &task = nested_task_map[state.range(0)];
   // mr::Executor::get().thread_count(state.range(1));
+  HeapCounters counters(state);
   for(auto _ : state) {
     auto x = task->execute().result();
     benchmark::DoNotOptimize(x);
@@ -35,8 +52,9 @@ BENCHMARK(BM_NestedTasks)
 ;
 
 void BM_FlatTasks(benchmark::State& state) {
-  auto &task = nested_task_map[state.range(0)];
+  auto &task = flat_task_map[state.range(0)];
   // mr::Executor::get().thread_count(state.range(1));
+  HeapCounters counters(state);
   for(auto _ : state) {
     auto x = task->execute().result();
     benchmark::DoNotOptimize(x);
@@ -50,6 +68,431 @@ BENCHMARK(BM_FlatTasks)
   ->Complexity()
 ;
 
+// same flat sequences, run through the `Task` handle or held by value as `StaticTask`
+template <size_t ...Is>
+auto make_flat_sequence(std::index_sequence<Is...>) {
+  return mr::Sequence { std::function<int(int)>([](int) -> int { return Is; })... };
+}
+
+template <size_t N>
+void BM_FlatStaticTasks(benchmark::State& state) {
+  static auto prototype = make_flat_sequence(std::make_index_sequence<N>());
+  bool is_static = state.range(0);
+  bool oneshot = state.range(1); // the task is created by every iteration
+
+  if (oneshot) {
+    HeapCounters counters(state);
+    for (auto _ : state) {
+      if (is_static) {
+        auto task = mr::apply_static(prototype, 0);
+        benchmark::DoNotOptimize(task->execute().result());
+      } else {
+        auto task = mr::apply(prototype, 0);
+        benchmark::DoNotOptimize(task->execute().result());
+      }
+    }
+  } else if (is_static) {
+    auto task = mr::apply_static(prototype, 0);
+    HeapCounters counters(state);
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(task->execute().result());
+    }
+  } else {
+    auto task = mr::apply(prototype, 0);
+    HeapCounters counters(state);
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(task->execute().result());
+    }
+  }
+}
+BENCHMARK(BM_FlatStaticTasks<1>)
+  ->ArgNames({"static", "oneshot"})
+  ->ArgsProduct({{0, 1}, {0, 1}})
+  ->Unit(benchmark::kMicrosecond)
+;
+BENCHMARK(BM_FlatStaticTasks<16>)
+  ->ArgNames({"static", "oneshot"})
+  ->ArgsProduct({{0, 1}, {0, 1}})
+  ->Unit(benchmark::kMicrosecond)
+;
+
+void BM_DynamicTasks(benchmark::State& state) {
+  auto &task = dynamic_task_map[state.range(0)];
+  HeapCounters counters(state);
+  for(auto _ : state) {
+    auto x = task->execute().result();
+    benchmark::DoNotOptimize(x);
+  }
+}
+BENCHMARK(BM_DynamicTasks)
+  ->RangeMultiplier(2)
+  ->Range(1, 128)
+  ->Unit(benchmark::kMillisecond)
+;
+
+// bursts of work separated by quiet periods,
+// shows latency of a burst and CPU time burnt per burst for fixed and elastic pools
+void BM_BurstyLoad(benchmark::State& state) {
+  using namespace std::chrono_literals;
+
+  auto &executor = mr::Executor::get();
+  if (state.range(0)) {
+    executor.elastic({.min_threads = 1, .max_threads = mr::Executor::threadcount, .idle_timeout = 2ms});
+  } else {
+    executor.thread_count(mr::Executor::threadcount);
+  }
+
+  auto work = [](int x) -> int {
+    auto until = Clock::now() + 50us;
+    while (Clock::now() < until) {
+      benchmark::DoNotOptimize(x++);
+    }
+    return x;
+  };
+  auto burst = mr::Parallel {work, work, work, work, work, work, work, work};
+  auto task = mr::apply(burst, {0, 1, 2, 3, 4, 5, 6, 7});
+
+  auto cpu_start = std::clock();
+  for (auto _ : state) {
+    std::this_thread::sleep_for(10ms);
+
+    auto start = Clock::now();
+    auto x = task->execute().result();
+    state.SetIterationTime(duration(Clock::now() - start).count());
+    benchmark::DoNotOptimize(x);
+  }
+  auto cpu_ms = 1000.0 * (std::clock() - cpu_start) / CLOCKS_PER_SEC;
+  state.counters["cpu_ms_per_burst"] = benchmark::Counter(cpu_ms, benchmark::Counter::kAvgIterations);
+
+  executor.thread_count(mr::Executor::threadcount);
+}
+BENCHMARK(BM_BurstyLoad)
+  ->ArgName("elastic")
+  ->Arg(0)
+  ->Arg(1)
+  ->UseManualTime()
+  ->Unit(benchmark::kMicrosecond)
+;
+
+// overload: tasks with random deadlines and more work than the pool finishes before most of them,
+// shows the share of tasks which missed their deadline when served earliest deadline first and in FIFO order
+void BM_DeadlineMisses(benchmark::State& state) {
+  using namespace std::chrono_literals;
+  constexpr int count = 64;
+  constexpr auto stage_time = 100us;
+
+  auto work = [stage_time](int x) -> int {
+    auto until = Clock::now() + stage_time;
+    while (Clock::now() < until) {
+      benchmark::DoNotOptimize(x);
+    }
+    return x;
+  };
+
+  std::vector<mr::Deadline::Clock::time_point> done(count);
+  auto prototype = mr::Sequence {
+    work,
+    work,
+    [&done](int i) -> int {
+      done[i] = mr::Deadline::Clock::now();
+      return i;
+    }
+  };
+
+  std::vector<mr::Task<int>> tasks;
+  for (int i = 0; i < count; i++) {
+    tasks.push_back(mr::apply(prototype, i));
+  }
+
+  std::mt19937 rng(47);
+  // deadlines are spread over 3/2 of the time the pool needs for all tasks, early ones cannot all be met
+  auto budget = count * 2 * stage_time * 3 / 2 / std::max(mr::Executor::get().thread_count(), 1);
+  std::uniform_int_distribution<std::int64_t> spread(0, std::chrono::nanoseconds(budget).count());
+  std::vector<mr::Deadline::Clock::time_point> deadlines(count);
+
+  size_t missed = 0;
+  size_t total = 0;
+  for (auto _ : state) {
+    auto start = mr::Deadline::Clock::now();
+    for (int i = 0; i < count; i++) {
+      deadlines[i] = start + std::chrono::nanoseconds(spread(rng));
+      tasks[i]->set_deadline(state.range(0) ? mr::Deadline {deadlines[i]} : mr::Deadline {});
+      tasks[i]->schedule();
+    }
+    for (auto &task : tasks) {
+      task->wait();
+    }
+
+    for (int i = 0; i < count; i++) {
+      missed += done[i] > deadlines[i];
+    }
+    total += count;
+  }
+  state.counters["miss_rate"] = double(missed) / total;
+}
+BENCHMARK(BM_DeadlineMisses)
+  ->ArgName("edf")
+  ->Arg(0)
+  ->Arg(1)
+  ->Unit(benchmark::kMillisecond)
+;
+
+// minimal thread pool standing in for an existing one, fed through `mr::PoolBackend`
+struct SimplePool {
+  explicit SimplePool(int size) {
+    for (int i = 0; i < size; i++) {
+      _threads.emplace_back([this](const std::stop_token &token) { run(token); });
+    }
+  }
+
+  void post(std::function<void()> job) {
+    {
+      std::lock_guard lock(_mutex);
+      _jobs.push_back(std::move(job));
+    }
+    _cv.notify_one();
+  }
+
+  // lets a waiting thread run a pending job
+  bool try_run_one() {
+    std::unique_lock lock(_mutex);
+    if (_jobs.empty()) {
+      return false;
+    }
+    auto job = std::move(_jobs.front());
+    _jobs.pop_front();
+    lock.unlock();
+    job();
+    return true;
+  }
+
+private:
+  void run(const std::stop_token &token) {
+    while (true) {
+      std::function<void()> job;
+      {
+        std::unique_lock lock(_mutex);
+        if (not _cv.wait(lock, token, [this] { return not _jobs.empty(); })) {
+          return;
+        }
+        job = std::move(_jobs.front());
+        _jobs.pop_front();
+      }
+      job();
+    }
+  }
+
+  std::mutex _mutex;
+  std::condition_variable_any _cv;
+  std::deque<std::function<void()>> _jobs;
+  std::vector<std::jthread> _threads; // NOTE: joined first
+};
+
+// the same nested tasks run by the work contract group (0), inline on the caller (1) and by an external pool (2),
+// the inline backend shows the pure overhead of the library
+void BM_Backends(benchmark::State& state) {
+  auto &executor = mr::Executor::get();
+  std::optional<SimplePool> pool;
+  if (state.range(0) == 1) {
+    executor.backend(mr::InlineBackend {});
+  } else if (state.range(0) == 2) {
+    pool.emplace(mr::Executor::threadcount);
+    executor.backend(mr::PoolBackend {
+      [&pool](auto run) { pool->post(std::move(run)); },
+      [&pool]() { return pool->try_run_one(); }
+    });
+  }
+
+  auto &task = nested_task_map[state.range(1)];
+  for (auto _ : state) {
+    auto x = task->execute().result();
+    benchmark::DoNotOptimize(x);
+  }
+
+  executor.default_backend();
+}
+BENCHMARK(BM_Backends)
+  ->ArgNames({"backend", "size"})
+  ->ArgsProduct({{0, 1, 2}, {1, 8, 64}})
+  ->Unit(benchmark::kMicrosecond)
+;
+
+// parallel algorithm stages (std:0) against their std::execution::par counterparts (std:1)
+static const std::vector<int64_t> kAlgorithmImpls = {
+  0,
+#ifdef __cpp_lib_parallel_algorithm
+  1,
+#endif
+};
+
+std::vector<int64_t> random_values(size_t size) {
+  std::mt19937 rng(47);
+  std::uniform_int_distribution<int64_t> values(0, 1000);
+  std::vector<int64_t> res(size);
+  std::generate(res.begin(), res.end(), [&] { return values(rng); });
+  return res;
+}
+
+void BM_Reduce(benchmark::State& state) {
+  auto input = random_values(state.range(1));
+  auto reduce = mr::Reduce<int64_t> {};
+  for (auto _ : state) {
+    int64_t x = 0;
+    if (state.range(0) == 0) {
+      x = reduce(input);
+    } else {
+#ifdef __cpp_lib_parallel_algorithm
+      x = std::reduce(std::execution::par, input.begin(), input.end(), int64_t(0));
+#endif
+    }
+    benchmark::DoNotOptimize(x);
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_Reduce)
+  ->ArgNames({"std", "size"})
+  ->ArgsProduct({kAlgorithmImpls, {1 << 16, 1 << 20, 1 << 24}})
+  ->Unit(benchmark::kMicrosecond)
+;
+
+void BM_Scan(benchmark::State& state) {
+  auto input = random_values(state.range(1));
+  auto scan = mr::Scan<int64_t> {};
+  for (auto _ : state) {
+    // NOTE: both sides work on a fresh copy of the input
+    auto x = input;
+    if (state.range(0) == 0) {
+      x = scan(std::move(x));
+    } else {
+#ifdef __cpp_lib_parallel_algorithm
+      std::inclusive_scan(std::execution::par, x.begin(), x.end(), x.begin());
+#endif
+    }
+    benchmark::DoNotOptimize(x.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_Scan)
+  ->ArgNames({"std", "size"})
+  ->ArgsProduct({kAlgorithmImpls, {1 << 16, 1 << 20, 1 << 24}})
+  ->Unit(benchmark::kMicrosecond)
+;
+
+void BM_Sort(benchmark::State& state) {
+  auto input = random_values(state.range(1));
+  auto sort = mr::Sort<int64_t> {};
+  for (auto _ : state) {
+    auto x = input;
+    if (state.range(0) == 0) {
+      x = sort(std::move(x));
+    } else {
+#ifdef __cpp_lib_parallel_algorithm
+      std::sort(std::execution::par, x.begin(), x.end());
+#endif
+    }
+    benchmark::DoNotOptimize(x.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_Sort)
+  ->ArgNames({"std", "size"})
+  ->ArgsProduct({kAlgorithmImpls, {1 << 16, 1 << 20, 1 << 24}})
+  ->Unit(benchmark::kMicrosecond)
+;
+
+// ================= Output Padding =================
+// same size as `std::uint32_t`, but opted out of padding, so branch outputs are written next to each other
+struct PackedOutput {
+  std::uint32_t value;
+};
+
+template <>
+  inline constexpr bool mr::enable_output_padding<PackedOutput> = false;
+
+// wide `Parallel` of tiny branches, each one only computes and writes a 4 byte output
+template <typename OutT, size_t ...Is>
+auto make_wide_parallel(std::index_sequence<Is...>) {
+  return mr::Parallel {
+    [](std::uint32_t x) -> OutT {
+      for (size_t i = 0; i < 64; i++) {
+        x = x * 1664525u + 1013904223u + Is;
+      }
+      return {x};
+    }...
+  };
+}
+
+constexpr size_t kWideParallelBranches = 32;
+
+template <typename OutT>
+void run_wide_parallel(benchmark::State& state) {
+  auto prototype = make_wide_parallel<OutT>(std::make_index_sequence<kWideParallelBranches>());
+  auto task = [&]<size_t ...Is>(std::index_sequence<Is...>) {
+    return mr::apply(prototype, std::tuple((static_cast<std::uint32_t>(Is) + 1)...));
+  }(std::make_index_sequence<kWideParallelBranches>());
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(task->execute().result_ref());
+  }
+  state.SetItemsProcessed(state.iterations() * kWideParallelBranches);
+}
+
+void BM_OutputPadding(benchmark::State& state) {
+  if (state.range(0)) {
+    run_wide_parallel<std::uint32_t>(state);
+  } else {
+    run_wide_parallel<PackedOutput>(state);
+  }
+}
+BENCHMARK(BM_OutputPadding)
+  ->ArgNames({"padded"})
+  ->Arg(0)->Arg(1)
+  ->Unit(benchmark::kMicrosecond)
+;
+
+// ================= Payload Traffic =================
+// payloads of growing size pushed through three stages (or branches) which take and return them by value,
+// copies per iteration show what the library copies on its own, moves are free
+constexpr std::initializer_list<int64_t> kPayloadSizes {8, 1 << 10, 1 << 16, 1 << 20, 1 << 24};
+
+auto pass_payload = [](Payload p) -> Payload {
+  benchmark::DoNotOptimize(p.bytes.data());
+  return p;
+};
+
+void BM_PayloadSequence(benchmark::State& state) {
+  static auto prototype = mr::Sequence {pass_payload, pass_payload, pass_payload};
+  auto task = mr::apply(prototype, Payload(state.range(0)));
+
+  HeapCounters counters(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(task->execute().result_ref().bytes.data());
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PayloadSequence)
+  ->ArgNames({"bytes"})
+  ->ArgsProduct({kPayloadSizes})
+  ->Unit(benchmark::kMicrosecond)
+;
+
+void BM_PayloadParallel(benchmark::State& state) {
+  static auto prototype = mr::Parallel {pass_payload, pass_payload, pass_payload};
+  auto size = state.range(0);
+  auto task = mr::apply(prototype, std::tuple(Payload(size), Payload(size), Payload(size)));
+
+  HeapCounters counters(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(std::get<0>(task->execute().result_ref()).bytes.data());
+  }
+  state.SetBytesProcessed(state.iterations() * 3 * size);
+}
+BENCHMARK(BM_PayloadParallel)
+  ->ArgNames({"bytes"})
+  ->ArgsProduct({kPayloadSizes})
+  ->Unit(benchmark::kMicrosecond)
+;
+
 // ================= Main Function =================
 int main(int argc, char** argv) {
   benchmark::Initialize(&argc, argv);
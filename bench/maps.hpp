@@ -337,3 +337,24 @@ inline auto create_flat_task_map() -> TaskMap {
 
   return res;
 }
+
+// same stages as `create_flat_task_map`, composed at runtime
+inline auto create_dynamic_task_map() -> TaskMap {
+  constexpr int size = 128;
+
+  TaskMap res;
+
+  static std::map<size_t, mr::DynamicSequence<int, int>> prototypes;
+  for (int n = 1; n <= size; n *= 2) {
+    // NOTE: filled by the first call only, as the `static` prototypes of the other maps
+    auto &prototype = prototypes[n];
+    if (prototype.size() == 0) {
+      for (int i = 0; i < n; i++) {
+        prototype.push_back(std::function<int(int)>([i](int) -> int { return i; }));
+      }
+    }
+    res[n] = mr::apply(prototype, 0);
+  }
+
+  return res;
+}
@@ -41,3 +41,9 @@ set(MR_CONTRACTOR_BENCH_DEPS
   platform_config
   ${CORESERVICES}
 )
+
+# parallel backend of std::execution (libstdc++), the algorithm benchmarks compare against it
+find_package(TBB QUIET)
+if (TBB_FOUND)
+  list(APPEND MR_CONTRACTOR_BENCH_DEPS TBB::tbb)
+endif()
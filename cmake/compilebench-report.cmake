@@ -0,0 +1,20 @@
+# Prints the table of the compile-time benchmark.
+# Objects are removed afterwards, so every run of the target compiles (and measures) them again
+string(REPLACE "," ";" STAGES "${STAGES}")
+
+message("stages  compile, ms  object, KiB")
+foreach(stages IN LISTS STAGES)
+  file(READ ${DIR}/time_${stages}.txt elapsed)
+  file(SIZE ${OBJECT_${stages}} size)
+  math(EXPR size "${size} / 1024")
+
+  string(LENGTH "${stages}" stages_width)
+  string(LENGTH "${elapsed}" elapsed_width)
+  math(EXPR stages_pad "8 - ${stages_width}")
+  math(EXPR elapsed_pad "13 - ${elapsed_width}")
+  string(REPEAT " " ${stages_pad} stages_pad)
+  string(REPEAT " " ${elapsed_pad} elapsed_pad)
+  message("${stages}${stages_pad}${elapsed}${elapsed_pad}${size}")
+
+  file(REMOVE ${OBJECT_${stages}})
+endforeach()
@@ -0,0 +1,23 @@
+# Compiler launcher of the compile-time benchmark:
+# runs the command which follows `--` and writes its wall time in milliseconds into REPORT
+set(command)
+set(found FALSE)
+math(EXPR last "${CMAKE_ARGC} - 1")
+foreach(i RANGE ${last})
+  if (found)
+    list(APPEND command "${CMAKE_ARGV${i}}")
+  elseif ("${CMAKE_ARGV${i}}" STREQUAL "--")
+    set(found TRUE)
+  endif()
+endforeach()
+
+string(TIMESTAMP start "%s%f")
+execute_process(COMMAND ${command} RESULT_VARIABLE result)
+string(TIMESTAMP finish "%s%f")
+
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "compilation failed: ${result}")
+endif()
+
+math(EXPR elapsed "(${finish} - ${start}) / 1000")
+file(WRITE ${REPORT} ${elapsed})
@@ -0,0 +1,55 @@
+# Compile-time benchmark: flat prototypes of 16 to 512 stages.
+# `cmake --build . --target mr-contractor-compile-bench` compiles each of them
+# and reports its compile time and object size
+set(MR_CONTRACTOR_COMPILE_BENCH_STAGES 16 32 64 128 256 512)
+set(MR_CONTRACTOR_COMPILE_BENCH_DIR ${CMAKE_CURRENT_BINARY_DIR}/compile-bench)
+
+set(compile_bench_targets)
+set(compile_bench_objects)
+foreach(stages IN LISTS MR_CONTRACTOR_COMPILE_BENCH_STAGES)
+  # stage `i` converts between the types below in turn, so the variant holds several alternatives
+  set(types int long float double)
+  set(body "")
+  math(EXPR last "${stages} - 1")
+  foreach(i RANGE ${last})
+    math(EXPR from "${i} % 4")
+    math(EXPR to "(${i} + 1) % 4")
+    list(GET types ${from} from)
+    list(GET types ${to} to)
+    string(APPEND body "  [](${from} x) -> ${to} { return x + ${i}; },\n")
+  endforeach()
+
+  set(source ${MR_CONTRACTOR_COMPILE_BENCH_DIR}/sequence_${stages}.cpp)
+  file(CONFIGURE OUTPUT ${source} CONTENT
+"#include <mr-contractor/contractor.hpp>
+
+static auto prototype = mr::Sequence {
+${body}};
+
+int run(int x) {
+  return mr::apply(prototype, x)->execute().result();
+}
+")
+
+  set(target ${MR_CONTRACTOR_COMPILE_BENCH_NAME}-${stages})
+  add_library(${target} OBJECT EXCLUDE_FROM_ALL ${source})
+  target_link_libraries(${target} PRIVATE ${MR_CONTRACTOR_LIB_NAME})
+  # compile command is run through a launcher which records its wall time
+  set_target_properties(${target} PROPERTIES CXX_COMPILER_LAUNCHER
+    "${CMAKE_COMMAND};-DREPORT=${MR_CONTRACTOR_COMPILE_BENCH_DIR}/time_${stages}.txt;-P;${CMAKE_CURRENT_LIST_DIR}/compilebench-time.cmake;--"
+  )
+
+  list(APPEND compile_bench_targets ${target})
+  list(APPEND compile_bench_objects "-DOBJECT_${stages}=$<TARGET_OBJECTS:${target}>")
+endforeach()
+
+list(JOIN MR_CONTRACTOR_COMPILE_BENCH_STAGES "," compile_bench_stages)
+add_custom_target(${MR_CONTRACTOR_COMPILE_BENCH_NAME}
+  COMMAND ${CMAKE_COMMAND}
+    -DSTAGES=${compile_bench_stages}
+    -DDIR=${MR_CONTRACTOR_COMPILE_BENCH_DIR}
+    ${compile_bench_objects}
+    -P ${CMAKE_CURRENT_LIST_DIR}/compilebench-report.cmake
+  DEPENDS ${compile_bench_targets}
+  VERBATIM
+)
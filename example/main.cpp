@@ -1,6 +1,9 @@
-#include <filesystem>
-#include <fstream>
+#include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
 
 #include <mr-contractor/contractor.hpp>
 
@@ -8,8 +11,8 @@ template <typename Ret, typename... Args>
 struct TaskPrototypeBuilder;
 
 template <typename Ret, typename... Args>
-auto get_task_prototype() {
-  return std::ref(TaskPrototypeBuilder<Ret, Args...>::create());
+auto & get_task_prototype() {
+  return TaskPrototypeBuilder<Ret, Args...>::create();
 }
 
 template <typename ResultT, typename ...Args>
@@ -38,23 +41,23 @@ template <>
 struct TaskPrototypeBuilder<Image, std::filesystem::path> {
   inline static auto & create() {
     static auto prototype = mr::Sequence {
-      [](std::filesystem::path filename) -> Image {
-        std::ifstream input_file(filename.string(), std::ios::binary | std::ios::ate);
-
-        size_t file_size = static_cast<size_t>(input_file.tellg());
-        std::unique_ptr<uint8_t> buffer = std::make_unique<uint8_t[]>(file_size);
-
-        input_file.seekg(0);
-        input_file.read(buffer.data(), file_size);
+      // the file is mapped and read in on the I/O pool
+      mr::map_file,
+      // decoding runs on the compute executor and reads the mapping in place
+      [](mr::MappedFile file) -> Image {
+        auto bytes = file.bytes();
 
         int height;
         int width;
 
-        height = width = std::sqrt(file_size);
+        height = width = static_cast<int>(std::sqrt(bytes.size()));
+
+        assert(static_cast<size_t>(height * width) == bytes.size());
 
-        assert(height * width == file_size);
+        auto pixels = std::make_unique<uint8_t[]>(bytes.size());
+        std::memcpy(pixels.get(), bytes.data(), bytes.size());
 
-        return {buffer, height, width};
+        return {std::move(pixels), height, width};
       }
     };
     return prototype;
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <numeric>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "mr-contractor/def.hpp"
+#include "mr-contractor/executor.hpp"
+
+namespace mr::detail {
+  // Runs `body(participant, chunk)` for every chunk in [0, chunks) on contracts of the executor
+  // and on the calling thread. Chunks are claimed one by one, so uneven ones balance out,
+  // `participant` is in [0, count) and no two threads share it.
+  // NOTE: storage per participant has to be sized with the same `count`, the pool may grow meanwhile
+  template <typename F>
+    void fork_join(size_t chunks, size_t count, F &&body);
+
+  inline size_t participants(size_t chunks) noexcept {
+    auto helpers = static_cast<size_t>(std::max(Executor::get().thread_count(), 0));
+    return std::min(chunks, helpers + 1);
+  }
+
+  // as many participants as there are workers (and the calling thread)
+  template <typename F>
+    void fork_join(size_t chunks, F &&body) {
+      fork_join(chunks, participants(chunks), std::forward<F>(body));
+    }
+
+  template <typename F>
+    void fork_join(size_t chunks, size_t count, F &&body) {
+      if (count <= 1) {
+        for (size_t i = 0; i < chunks; i++) {
+          body(0, i);
+        }
+        return;
+      }
+
+      std::atomic<size_t> next = 0;
+      // helpers which returned, they refer to this frame until then
+      std::atomic<size_t> finished = 0;
+      auto drain = [&](size_t participant) {
+        for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < chunks; i = next.fetch_add(1, std::memory_order_relaxed)) {
+          body(participant, i);
+        }
+      };
+
+      std::vector<Contract> helpers;
+      helpers.reserve(count - 1);
+      for (size_t p = 1; p < count; p++) {
+        helpers.push_back(Executor::get().create_contract(
+          [&drain, &finished, p]() {
+            drain(p);
+            finished.fetch_add(1, std::memory_order_release);
+            Executor::get().notify_waiters();
+          }
+        ));
+        helpers.back().schedule(Executor::current_deadline());
+      }
+
+      drain(0);
+      Executor::get().help_until([&] { return finished.load(std::memory_order_acquire) == count - 1; });
+    }
+
+  inline size_t chunk_count(size_t size, size_t grain) noexcept {
+    grain = std::max<size_t>(grain, 1);
+    return (size + grain - 1) / grain;
+  }
+}
+
+namespace mr {
+  // Parallel fold of a vector, `op` has to be associative and commutative (as for `std::reduce`).
+  // Every participating worker folds the chunks it claimed into its own (padded) partial result,
+  // partials are combined with `init` on the calling thread
+  template <typename T, typename Op = std::plus<>>
+    struct Reduce {
+      T init {};
+      Op op {};
+      size_t grain = 4096; // elements per chunk
+
+      T operator()(const std::vector<T> &input) const {
+        auto chunks = detail::chunk_count(input.size(), grain);
+        auto count = detail::participants(chunks);
+        std::vector<detail::Padded<std::optional<T>>> partials(count);
+
+        detail::fork_join(chunks, count, [&](size_t participant, size_t chunk) {
+          auto first = input.begin() + chunk * grain;
+          auto last = input.begin() + std::min(input.size(), (chunk + 1) * grain);
+
+          T sum = *first;
+          for (++first; first != last; ++first) {
+            sum = op(std::move(sum), *first);
+          }
+
+          auto &partial = partials[participant].value;
+          partial = partial.has_value() ? op(std::move(*partial), std::move(sum)) : std::move(sum);
+        });
+
+        T res = init;
+        for (auto &partial : partials) {
+          if (partial.value.has_value()) {
+            res = op(std::move(res), std::move(*partial.value));
+          }
+        }
+        return res;
+      }
+    };
+
+  template <typename T>
+    Reduce(T) -> Reduce<T>;
+  template <typename T, typename Op>
+    Reduce(T, Op) -> Reduce<T, Op>;
+  template <typename T, typename Op>
+    Reduce(T, Op, size_t) -> Reduce<T, Op>;
+
+  // Parallel inclusive prefix sum, `op` has to be associative.
+  // Chunks are scanned in place, then every chunk but the first is offset by the total of the preceding ones
+  template <typename T, typename Op = std::plus<>>
+    struct Scan {
+      Op op {};
+      size_t grain = 4096;
+
+      std::vector<T> operator()(std::vector<T> input) const {
+        auto chunks = detail::chunk_count(input.size(), grain);
+        auto range = [&](size_t chunk) {
+          return std::pair(input.begin() + chunk * grain, input.begin() + std::min(input.size(), (chunk + 1) * grain));
+        };
+
+        detail::fork_join(chunks, [&](size_t, size_t chunk) {
+          auto [first, last] = range(chunk);
+          std::inclusive_scan(first, last, first, op);
+        });
+
+        // NOTE: one value per chunk, sequential and cheap
+        std::vector<T> offsets;
+        offsets.reserve(chunks);
+        for (size_t chunk = 0; chunk + 1 < chunks; chunk++) {
+          const auto &total = *(range(chunk).second - 1);
+          offsets.push_back(offsets.empty() ? total : op(offsets.back(), total));
+        }
+
+        detail::fork_join(chunks - std::min<size_t>(chunks, 1), [&](size_t, size_t chunk) {
+          auto [first, last] = range(chunk + 1);
+          const auto &offset = offsets[chunk];
+          for (; first != last; ++first) {
+            *first = op(offset, std::move(*first));
+          }
+        });
+        return input;
+      }
+    };
+
+  // Parallel merge sort: chunks are sorted independently, then merged pairwise in rounds.
+  // NOTE: the last rounds have less merges than workers, the final one runs on a single thread
+  template <typename T, typename Compare = std::less<>>
+    struct Sort {
+      Compare comp {};
+      size_t grain = 4096;
+
+      std::vector<T> operator()(std::vector<T> input) const {
+        auto chunks = detail::chunk_count(input.size(), grain);
+        auto at = [&](size_t chunk) {
+          return input.begin() + std::min(input.size(), chunk * grain);
+        };
+
+        detail::fork_join(chunks, [&](size_t, size_t chunk) {
+          std::sort(at(chunk), at(chunk + 1), comp);
+        });
+
+        // sorted runs of `width` chunks are merged into runs of `2 * width`
+        for (size_t width = 1; width < chunks; width *= 2) {
+          detail::fork_join((chunks + 2 * width - 1) / (2 * width), [&](size_t, size_t pair) {
+            auto first = pair * 2 * width;
+            if (first + width < chunks) {
+              std::inplace_merge(at(first), at(first + width), at(first + 2 * width), comp);
+            }
+          });
+        }
+        return input;
+      }
+    };
+}
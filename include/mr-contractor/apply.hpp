@@ -5,6 +5,7 @@
 #include "stages.hpp"
 #include "traits.hpp"
 #include "task.hpp"
+#include "dynamic.hpp"
 
 namespace mr::detail {
   // size_t I: index of a Stage in target task
@@ -14,20 +15,34 @@ namespace mr::detail {
 
   // add(Seq, Func)
   template <size_t I, typename OutputT, typename InputT>
-    inline void add(SeqTaskImplInstance auto &task, FunctionView<OutputT(InputT)> stage) {
-      auto contract = Executor::get().group.create_contract(
+    inline void add(SeqTaskImplInstance auto &task, FunctionView<OutputT(InputT &&)> stage) {
+      auto contract = Executor::get().create_contract(
         [&task, stage]() mutable {
-          if constexpr (std::is_same_v<InputT, void>) {
-            task._object->template emplace<OutputT>(stage());
-          } else {
-            task._object->template emplace<OutputT>(stage(std::move(std::get<InputT>(*task._object.get()))));
+          if (task.expired()) {
+            task.complete();
+            return;
+          }
+          if (task._incremental) {
+            nested_slot = &task._nested[I];
           }
+          group_slot = &task._groups[I];
+
+          auto invoke = [&task, &stage]() -> OutputT {
+            return stage(std::move(std::get<InputT>(*task._object.get())));
+          };
 
+          // NOTE: the input lives in the same variant, so the output can only be stored after the call
+          // NOTE: children spawned by the stage into its group finish before the task goes on
           if constexpr (I < std::remove_reference_t<decltype(task)>::size - 1) {
-            task.contracts[I + 1].schedule();
+            task._object->template emplace<OutputT>(invoke());
+            then(task._groups[I], [&task]() noexcept { task.contracts[I + 1].schedule(task.deadline()); });
           } else {
-            task.completion_flag.test_and_set(std::memory_order_release);
-            task.completion_flag.notify_one();
+            if (task._destination != nullptr) {
+              task._destination->emplace(elide<OutputT>(invoke));
+            } else {
+              task._object->template emplace<OutputT>(invoke());
+            }
+            then(task._groups[I], [&task]() noexcept { task.complete(); });
           }
         }
       );
@@ -37,16 +52,38 @@ namespace mr::detail {
 
   // add(Par, Func)
   template <size_t I, typename OutputT, typename InputT>
-    inline void add(ParTaskImplInstance auto &task, FunctionView<OutputT(InputT)> stage) {
-      auto contract = Executor::get().group.create_contract(
+    inline void add(ParTaskImplInstance auto &task, FunctionView<OutputT(InputT &&)> stage) {
+      auto contract = Executor::get().create_contract(
         [&task, stage]() mutable {
-          std::get<I>(*task._object.get()) = stage(std::move(std::get<I>(task._input)));
+          if (task.expired()) {
+            task.arrive();
+            return;
+          }
 
-          if constexpr (I < std::remove_reference_t<decltype(task)>::size - 1) {
-            [[maybe_unused]] auto _ = task._barrier.arrive(); /* to suppress nodiscard warning */
+          // NOTE: a skipped branch keeps the output of its previous run, which its cache refers to
+          auto *caches = task._caches.get();
+          if (caches != nullptr) {
+            if (caches->template hit<I>(task._input)) {
+              task.arrive();
+              return;
+            }
+            nested_slot = &task._nested[I];
+          }
+          group_slot = &task._groups[I];
+
+          // NOTE: branches of a `Broadcast` take the shared input by const reference, it is never moved from
+          if (task._measure_costs) {
+            using Clock = std::chrono::steady_clock;
+            auto start = Clock::now();
+            task.template store<I>(stage(std::move(branch_input<I>(task._input))));
+            task._cost_model->record(I, Clock::now() - start);
           } else {
-            task._barrier.arrive_and_wait();
+            task.template store<I>(stage(std::move(branch_input<I>(task._input))));
           }
+          if (caches != nullptr) {
+            caches->template commit<I>();
+          }
+          then(task._groups[I], [&task]() noexcept { task.arrive(); });
         }
       );
 
@@ -143,6 +180,30 @@ namespace mr::detail {
       add<I>(task, FunctionView<OutputT(void)>(callable));
     }
 #endif
+
+  // contracts of all stages of `stage`
+  template <StageT S>
+    void add_stages(typename S::TaskImplT &task, const S &stage) {
+      if constexpr (DynamicT<S>) {
+        add_dynamic(task, stage);
+      } else {
+        [&task, &stage]<size_t ...Is>(std::index_sequence<Is...>) {
+          (add<Is>(task, to_wrapper_view_v(get<Is>(stage.stages))), ...);
+          // NOTE: the contract after an I/O-bound one is scheduled by an I/O thread, but runs on the executor
+          ((S::io[Is] ? task.contracts[Is].route_to_io() : void()), ...);
+        }(std::make_index_sequence<S::size>());
+        for (size_t i = 0; i < S::size; i++) {
+          if (stage.resources[i]) {
+            task.contracts[i].limit(*stage.resources[i].limiter());
+          }
+        }
+      }
+      if constexpr (ParallelT<S> || BroadcastT<S>) {
+        if constexpr (S::TaskImplT::size > 1) {
+          task._cost_model = stage.cost_model.get();
+        }
+      }
+    }
 }
 
 namespace mr {
@@ -153,9 +214,7 @@ namespace mr {
       using TaskT = S::TaskT;
 
       auto task = std::make_unique<TaskImplT>(std::move(getter));
-      [&task, &stage]<size_t ...Is>(std::index_sequence<Is...>) {
-        (detail::add<Is>(*task.get(), detail::to_wrapper_view_v(std::get<Is>(stage.stages))), ...);
-      }(std::make_index_sequence<std::tuple_size_v<decltype(stage.stages)>>());
+      detail::add_stages(*task.get(), stage);
 
       return task;
     }
@@ -166,11 +225,144 @@ namespace mr {
       using TaskT = S::TaskT;
 
       auto task = std::make_unique<TaskImplT>(std::move(initial));
-      [&task, &stage]<size_t ...Is>(std::index_sequence<Is...>) {
-        (detail::add<Is>(*task.get(), detail::to_wrapper_view_v(std::get<Is>(stage.stages))), ...);
-      }(std::make_index_sequence<std::tuple_size_v<decltype(stage.stages)>>());
+      detail::add_stages(*task.get(), stage);
 
       return task;
     }
-}
 
+  // the result is constructed right into `destination` instead of the task's own storage,
+  // `result_ref()`/`result()` refer to it as well
+  // NOTE: `destination` has to outlive the task
+  template <StageT S>
+    typename S::TaskT apply_into(const S &stage, typename S::InputT initial, std::optional<typename S::OutputT> &destination) {
+      auto task = mr::apply(stage, std::move(initial));
+      task->_destination = &destination;
+      return task;
+    }
+
+  template <StageT S>
+    typename S::TaskT apply_into(const S &stage, FunctionWrapper<typename S::InputT(void)> &&getter, std::optional<typename S::OutputT> &destination) {
+      auto task = mr::apply(stage, std::move(getter));
+      task->_destination = &destination;
+      return task;
+    }
+
+  // contracts of the task and of tasks nested into its stages are served earliest deadline first
+  template <StageT S>
+    typename S::TaskT apply(const S &stage, typename S::InputT initial, const Deadline &deadline) {
+      auto task = mr::apply(stage, std::move(initial));
+      task->set_deadline(deadline);
+      return task;
+    }
+
+  template <StageT S>
+    typename S::TaskT apply(const S &stage, FunctionWrapper<typename S::InputT(void)> &&getter, const Deadline &deadline) {
+      auto task = mr::apply(stage, std::move(getter));
+      task->set_deadline(deadline);
+      return task;
+    }
+
+  // Task held by value instead of a `Task` handle: members are not virtual, so calls are resolved
+  // (and inlined) at compile time, and the task costs no allocation of its own.
+  // Contracts refer to the task, so it can be neither copied nor moved and has to be constructed
+  // in place: `StaticTask task {prototype, initial}` or `auto task = apply_static(prototype, initial)`.
+  // NOTE: intermediate results are still stored on the heap, once per task
+  template <StageT S>
+    struct StaticTask {
+      using ImplT = typename S::TaskImplT;
+      using InputT = typename S::InputT;
+      using OutputT = typename S::OutputT;
+
+      StaticTask(const S &stage, InputT initial)
+        : _impl(std::move(initial))
+      {
+        detail::add_stages(_impl, stage);
+      }
+
+      StaticTask(const S &stage, FunctionWrapper<InputT(void)> &&getter)
+        : _impl(std::move(getter))
+      {
+        detail::add_stages(_impl, stage);
+      }
+
+      StaticTask(const StaticTask &) = delete;
+      StaticTask & operator=(const StaticTask &) = delete;
+      StaticTask(StaticTask &&) = delete;
+      StaticTask & operator=(StaticTask &&) = delete;
+
+      StaticTask & schedule() {
+        _impl.ImplT::schedule();
+        return *this;
+      }
+
+      StaticTask & wait() {
+        _impl.ImplT::wait();
+        return *this;
+      }
+
+      StaticTask & execute() {
+        return schedule().wait();
+      }
+
+      [[nodiscard]] OutputT result() {
+        return _impl.ImplT::result();
+      }
+
+      // valid until the next `schedule()`
+      OutputT & result_ref() {
+        return _impl.ImplT::result_ref();
+      }
+
+      bool is_ready() const noexcept {
+        return _impl.is_ready();
+      }
+
+      bool missed() const noexcept {
+        return _impl.missed();
+      }
+
+      void set_deadline(const Deadline &deadline) noexcept {
+        _impl.set_deadline(deadline);
+      }
+
+      // `task->execute()` reads the same as with a `Task`
+      StaticTask * operator->() noexcept {
+        return this;
+      }
+
+      const StaticTask * operator->() const noexcept {
+        return this;
+      }
+
+    private:
+      ImplT _impl;
+    };
+
+  template <StageT S>
+    StaticTask<S> apply_static(const S &stage, typename S::InputT initial) {
+      return StaticTask<S>(stage, std::move(initial));
+    }
+
+  template <StageT S>
+    StaticTask<S> apply_static(const S &stage, FunctionWrapper<typename S::InputT(void)> &&getter) {
+      return StaticTask<S>(stage, std::move(getter));
+    }
+
+  // unchanged `Parallel` branches reuse the output of the previous run instead of running again,
+  // inputs are compared by their `version()` (see `VersionedT`) or by equality.
+  // Nested prototypes are kept between runs as well, so only the part of the graph with changed inputs runs.
+  // NOTE: `result()` moves the outputs out and the next run computes all of them again, `result_ref()` keeps them
+  template <StageT S>
+    typename S::TaskT apply_incremental(const S &stage, typename S::InputT initial) {
+      auto task = mr::apply(stage, std::move(initial));
+      task->_incremental = true;
+      return task;
+    }
+
+  template <StageT S>
+    typename S::TaskT apply_incremental(const S &stage, FunctionWrapper<typename S::InputT(void)> &&getter) {
+      auto task = mr::apply(stage, std::move(getter));
+      task->_incremental = true;
+      return task;
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <concepts>
+#include <deque>
+#include <utility>
+
+#include "def.hpp"
+
+namespace mr {
+  // Runs contracts in place of the work contract group (see `Executor::backend`).
+  // `submit` has to run `work` exactly once, `work` stays valid until then.
+  // A contract is submitted again only once its previous run returned, repeated schedules are merged before.
+  // `execute_next` is called by threads waiting for a task, it runs one pending contract
+  // on the calling thread if the backend can do that and returns false otherwise.
+  template <typename T>
+    concept ExecutorBackendT = requires (T &backend, FunctionWrapper<void(void)> &work) {
+      backend.submit(work);
+      { backend.execute_next() } -> std::same_as<bool>;
+    };
+
+  // Runs every contract right away on the thread which schedules it,
+  // so a task is completed by `schedule()` itself. Measures the pure overhead of the library
+  // and suits graphs too small to be worth a thread hop.
+  // Contracts scheduled by a running one are queued and run after it returns, so the stack does not grow with the graph.
+  // NOTE: combine with `Executor::thread_count(0)` to get rid of idle workers as well
+  struct InlineBackend {
+    void submit(FunctionWrapper<void(void)> &work) {
+      if (_running) {
+        _pending.push_back(&work);
+        return;
+      }
+      _running = true;
+      work();
+      while (execute_next()) {
+      }
+      _running = false;
+    }
+
+    // runs a contract queued by the running one, e.g. while it waits for a nested task
+    bool execute_next() {
+      if (_pending.empty()) {
+        return false;
+      }
+      auto *work = _pending.front();
+      _pending.pop_front();
+      (*work)();
+      return true;
+    }
+
+  private:
+    inline static thread_local bool _running = false;
+    inline static thread_local std::deque<FunctionWrapper<void(void)> *> _pending;
+  };
+
+  // Feeds an existing thread pool, `post` is called with a copyable callable which runs one contract.
+  // `help` runs one pending job of the pool on the calling thread and returns false if there was none.
+  // NOTE: without `help` a task waited on inside the pool (e.g. a nested prototype) blocks its thread,
+  //       once all threads of the pool wait this way nothing progresses
+  template <typename PostT, typename HelpT = bool (*)()>
+    struct PoolBackend {
+      PostT post;
+      HelpT help = []() { return false; };
+
+      void submit(FunctionWrapper<void(void)> &work) {
+        post([&work]() { work(); });
+      }
+
+      bool execute_next() {
+        return help();
+      }
+    };
+
+  template <typename PostT>
+    PoolBackend(PostT) -> PoolBackend<PostT>;
+
+  template <typename PostT, typename HelpT>
+    PoolBackend(PostT, HelpT) -> PoolBackend<PostT, HelpT>;
+}
+
+namespace mr::detail {
+  struct BackendBase {
+    virtual ~BackendBase() = default;
+
+    virtual void submit(FunctionWrapper<void(void)> &work) = 0;
+    virtual bool execute_next() = 0;
+  };
+
+  template <ExecutorBackendT B>
+    struct BackendImpl : BackendBase {
+      B backend;
+
+      explicit BackendImpl(B backend)
+        : backend(std::move(backend))
+      {}
+
+      void submit(FunctionWrapper<void(void)> &work) override final {
+        backend.submit(work);
+      }
+
+      bool execute_next() override final {
+        return backend.execute_next();
+      }
+    };
+}
@@ -1,8 +1,20 @@
 #pragma once
 
 #include "def.hpp"
+#include "backend.hpp"
+#include "io.hpp"
 #include "executor.hpp"
+#include "incremental.hpp"
+#include "resource.hpp"
 #include "stages.hpp"
 #include "traits.hpp"
+#include "task_group.hpp"
 #include "task.hpp"
+#include "dynamic.hpp"
 #include "apply.hpp"
+#include "algorithm.hpp"
+#include "mapped_file.hpp"
+#include "periodic.hpp"
+#include "reentrant.hpp"
+#include "stream.hpp"
+#include "when.hpp"
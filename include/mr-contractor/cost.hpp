@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "def.hpp"
+
+namespace mr::detail {
+  // Per-branch cost of a `Parallel`, seeded with static estimates and refined by measurements.
+  // Branches are scheduled in descending cost order, so the critical path starts first
+  template <size_t N>
+    struct CostModel {
+      // branches are measured on the first run of a task and on every `sample_interval`-th one after it,
+      // so the clock is not read twice per branch on every run
+      static constexpr size_t sample_interval = 16;
+
+      explicit CostModel(const std::array<std::chrono::nanoseconds, N> &estimates) noexcept {
+        for (size_t i = 0; i < N; i++) {
+          _costs[i].value.store(estimates[i].count(), std::memory_order_relaxed);
+        }
+      }
+
+      std::chrono::nanoseconds cost(size_t i) const noexcept {
+        return std::chrono::nanoseconds(_costs[i].value.load(std::memory_order_relaxed));
+      }
+
+      // exponential moving average, concurrent updates may drop a sample which is fine for a heuristic
+      void record(size_t i, std::chrono::nanoseconds elapsed) noexcept {
+        auto old = _costs[i].value.load(std::memory_order_relaxed);
+        auto sample = static_cast<std::int64_t>(elapsed.count());
+        _costs[i].value.store(old == 0 ? sample : old + (sample - old) / 8, std::memory_order_relaxed);
+      }
+
+      // branch indices, the most expensive first (ties keep index order)
+      std::array<size_t, N> order() const noexcept {
+        std::array<std::int64_t, N> costs;
+        std::array<size_t, N> res;
+        for (size_t i = 0; i < N; i++) {
+          costs[i] = _costs[i].value.load(std::memory_order_relaxed);
+          res[i] = i;
+        }
+        // NOTE: N is the number of branches, insertion sort is enough
+        for (size_t i = 1; i < N; i++) {
+          for (size_t j = i; j > 0 && costs[res[j - 1]] < costs[res[j]]; j--) {
+            std::swap(res[j - 1], res[j]);
+          }
+        }
+        return res;
+      }
+
+    private:
+      // NOTE: branches record concurrently, each cost is on its own cache line
+      std::array<Padded<std::atomic<std::int64_t>>, N> _costs;
+    };
+}
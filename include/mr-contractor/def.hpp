@@ -3,10 +3,9 @@
 #include <tuple>
 #include <functional>
 #include <type_traits>
+#include <utility>
 #include <variant>
-#include <ranges>
 
-#include <mp/mp>
 #include <work_contract/work_contract.h>
 
 #include "traits.hpp"
@@ -15,46 +14,119 @@ namespace mr {
   template <typename Signature> using FunctionWrapper = fu2::unique_function<Signature>;
   template <typename Signature> using FunctionView = fu2::function_view<Signature>;
 
-  using Contract = bcpp::work_contract;
+  // NOTE: a fixed value instead of `std::hardware_destructive_interference_size`,
+  //       which depends on compiler flags (and warns about it) while layouts of public types depend on it
+#if defined(__APPLE__) && defined(__aarch64__)
+  inline constexpr size_t cache_line_size = 128;
+#else
+  inline constexpr size_t cache_line_size = 64;
+#endif
 
-  // meta-functions
-  template <typename ...Ts>
-    using to_tuple_t = std::tuple<Ts...>;
+  namespace detail {
+    // keeps values written by different threads on different cache lines
+    template <typename T>
+      struct alignas(cache_line_size) Padded {
+        T value;
+      };
 
-  template <typename ...Ts>
-    constexpr mp::vector<mp::info> unique_v(std::ranges::range auto &&ts) {
-      mp::vector<mp::info> res;
-
-      for (auto t : ts) {
-        bool contains = false;
-        for (auto r : res) {
-          if (r == t) {
-            contains = true;
-            break;
-          }
+    // converts to the result of `f()`, so `emplace(Elide(f))` constructs the result in place
+    // instead of moving it out of a temporary
+    template <typename F>
+      struct Elide {
+        F &f;
+
+        explicit Elide(F &f) noexcept : f(f) {}
+
+        operator std::invoke_result_t<F &>() const {
+          return f();
         }
-        if (!contains) {
-          res.push_back(t);
+      };
+
+    struct Unrelated {};
+
+    // `T` does not take just anything in a converting constructor (as `std::any` or `template <typename U> T(U &&)` do),
+    // such a constructor would capture `Elide` itself instead of converting it
+    template <typename T>
+      constexpr bool elidable = not std::is_constructible_v<T, Unrelated>;
+
+    // argument of `emplace<T>` which constructs the result of `f()` in place where possible
+    template <typename T, typename F>
+      auto elide(F &f) {
+        if constexpr (elidable<T>) {
+          return Elide(f);
+        } else {
+          return T(f());
         }
       }
+  }
 
-      return res;
-    }
-
+  // meta-functions
+  // NOTE: every one of them is linear in the number of types,
+  //       prototypes of hundreds of stages instantiate them on every apply
   template <typename ...Ts>
-    using to_variant_t = mp::apply_t<std::variant, unique_v(std::array{mp::meta<Ts>...})>;
+    using to_tuple_t = std::tuple<Ts...>;
 
-  template <typename ...Ts>
-    constexpr mp::vector<mp::info> erase_v(size_t ind, std::ranges::range auto &&ts) {
-      mp::vector<mp::info> res;
-      for (int i = 0; i < ts.size(); i++) {
-        if (i != ind) {
-          res.push_back(ts[i]);
-        }
+  namespace detail {
+    template <typename ...Ts> struct type_list {};
+
+    template <typename T> struct type_tag {};
+
+    // set of distinct types, membership is a base class lookup instead of pairwise comparisons
+    template <typename ...Us>
+      struct type_set : type_tag<Us>... {
+        template <typename T>
+          auto operator+(type_tag<T>) -> std::conditional_t<std::is_base_of_v<type_tag<T>, type_set>, type_set, type_set<Us..., T>>;
+
+        template <template <typename ...> typename To>
+          using apply_t = To<Us...>;
+      };
+
+    template <typename ...Ts>
+      struct unique {
+        using type = decltype((type_set<>{} + ... + type_tag<Ts>{}));
+      };
+
+    template <typename ...Ts>
+      using unique_t = typename unique<Ts...>::type;
+  }
+
+  namespace detail {
+    template <size_t I, typename T>
+      struct flat_leaf {
+        T value;
+      };
+
+    template <typename Is, typename ...Ts> struct flat_tuple_base;
+    template <size_t ...Is, typename ...Ts>
+      struct flat_tuple_base<std::index_sequence<Is...>, Ts...> : flat_leaf<Is, Ts>... {
+        constexpr flat_tuple_base(Ts ...values)
+          : flat_leaf<Is, Ts> {std::move(values)}...
+        {}
+      };
+
+    // Tuple whose elements are indexed bases of a single class instead of a chain of nested tuples,
+    // so its instantiation depth does not grow with the number of elements (e.g. stages of a prototype)
+    template <typename ...Ts>
+      struct flat_tuple : flat_tuple_base<std::index_sequence_for<Ts...>, Ts...> {
+        using flat_tuple_base<std::index_sequence_for<Ts...>, Ts...>::flat_tuple_base;
+      };
+
+    // element `I`, the base is found by deduction instead of recursion
+    template <size_t I, typename T>
+      constexpr T & get(flat_leaf<I, T> &leaf) noexcept {
+        return leaf.value;
+      }
+
+    template <size_t I, typename T>
+      constexpr const T & get(const flat_leaf<I, T> &leaf) noexcept {
+        return leaf.value;
       }
-      return res;
-    }
+  }
+
+  // variant of distinct `Ts` in order of their first occurrence
+  template <typename ...Ts>
+    using to_variant_t = typename detail::unique_t<Ts...>::template apply_t<std::variant>;
 
   template<size_t N, class... Ts>
-    using at_t = mp::type_of<std::array{mp::meta<Ts>...}[N]>;
+    using at_t = std::tuple_element_t<N, std::tuple<Ts...>>;
 }
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <algorithm>
+#include <any>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <typeindex>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "mr-contractor/def.hpp"
+#include "mr-contractor/executor.hpp"
+#include "stages.hpp"
+#include "traits.hpp"
+#include "task.hpp"
+
+namespace mr::detail {
+  // Stage of a `DynamicSequence`, values between stages are carried in `std::any`
+  struct ErasedStage {
+    FunctionWrapper<std::any(std::any &&)> function;
+    std::type_index input;
+    std::type_index output;
+    bool io = false;
+    Resource resource {};
+  };
+
+  template <typename S>
+    ErasedStage erase_stage(S &&stage) {
+      using InputT = input_t<S>;
+      using OutputT = output_t<S>;
+
+      // NOTE: the stage is moved into the wrapper below
+      auto resource = resource_of(stage);
+      return ErasedStage {
+        [wrapper = to_wrapper_v(std::forward<S>(stage))](std::any &&input) mutable -> std::any {
+          auto invoke = [&]() -> OutputT { return wrapper(std::move(*std::any_cast<InputT>(&input))); };
+          return std::any(std::in_place_type<OutputT>, elide<OutputT>(invoke));
+        },
+        typeid(InputT),
+        typeid(OutputT),
+        is_io<std::remove_cvref_t<S>>,
+        std::move(resource),
+      };
+    }
+
+  template <typename InputT, typename ResultT>
+    struct DynSeqTaskImpl : TaskBase<ResultT> {
+      InputT _initial;
+
+      FunctionWrapper<InputT(void)> _getter = [this]() -> InputT { return _initial; };
+      std::any _object;
+
+      std::vector<Contract> contracts;
+
+      DynSeqTaskImpl(InputT initial)
+        : _initial(std::move(initial))
+      {}
+
+      DynSeqTaskImpl(FunctionWrapper<InputT(void)> getter)
+        : _getter(std::move(getter))
+      {}
+
+      DynSeqTaskImpl(const DynSeqTaskImpl &) = delete;
+      DynSeqTaskImpl & operator=(const DynSeqTaskImpl &) = delete;
+
+      void update_object() override final {
+        this->reset_completion();
+        _object.template emplace<InputT>(elide<InputT>(_getter));
+      }
+
+      TaskBase<ResultT> & schedule() override final {
+        update_object();
+        contracts.front().schedule(this->deadline());
+        return *this;
+      }
+
+      TaskBase<ResultT> & wait() override final {
+        this->await();
+        return *this;
+      }
+
+      [[nodiscard]] ResultT result() override final {
+        return std::move(result_ref());
+      }
+
+      ResultT & result_ref() override final {
+        if (this->_destination != nullptr) {
+          return **this->_destination;
+        }
+        return *std::any_cast<ResultT>(&_object);
+      }
+    };
+
+  template <typename InputT, typename ResultT>
+    struct DynParTaskImpl : TaskBase<ResultT> {
+      InputT _initial;
+
+      FunctionWrapper<InputT(void)> _getter = [this]() -> InputT { return _initial; };
+
+      std::vector<Contract> contracts;
+
+      InputT _input;
+      ResultT _object;
+
+      // NOTE: `std::vector<bool>` packs its elements into shared words, so branches store into bytes of their own
+      //       and the last one copies them into the result
+      static constexpr bool packed = std::is_same_v<ResultT, std::vector<bool>>;
+      std::conditional_t<packed, std::unique_ptr<bool[]>, std::monostate> _unpacked;
+
+      // branches which have not finished yet, the last one completes the task
+      alignas(cache_line_size) std::atomic<size_t> _remaining = 0;
+
+      DynParTaskImpl(InputT initial)
+        : _initial(std::move(initial))
+      {}
+
+      DynParTaskImpl(FunctionWrapper<InputT(void)> getter)
+        : _getter(std::move(getter))
+      {}
+
+      DynParTaskImpl(const DynParTaskImpl &) = delete;
+      DynParTaskImpl & operator=(const DynParTaskImpl &) = delete;
+
+      // NOTE: branch `i` takes `_input[i]`, an input of another size is rejected before anything is scheduled
+      void update_object() override final {
+        auto input = _getter();
+        if (input.size() != contracts.size()) {
+          throw std::invalid_argument("mr::DynamicParallel: input size does not match the number of branches");
+        }
+        _input = std::move(input);
+
+        this->reset_completion();
+        _remaining.store(contracts.size(), std::memory_order_relaxed);
+        if (this->_destination != nullptr) {
+          this->_destination->emplace(contracts.size());
+        } else {
+          _object.resize(contracts.size());
+        }
+        if constexpr (packed) {
+          if (_unpacked == nullptr) {
+            _unpacked = std::make_unique<bool[]>(contracts.size());
+          }
+          std::copy(result_ref().begin(), result_ref().end(), _unpacked.get());
+        }
+      }
+
+      // called by branch `i` with its output
+      template <typename T>
+        void store(size_t i, T &&output) {
+          if constexpr (packed) {
+            _unpacked[i] = std::forward<T>(output);
+          } else {
+            result_ref()[i] = std::forward<T>(output);
+          }
+        }
+
+      TaskBase<ResultT> & schedule() override final {
+        update_object();
+        if (contracts.empty()) {
+          this->complete();
+        }
+        for (auto &c : contracts) {
+          c.schedule(this->deadline());
+        }
+        return *this;
+      }
+
+      TaskBase<ResultT> & wait() override final {
+        this->await();
+        return *this;
+      }
+
+      void arrive() noexcept {
+        if (_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          if constexpr (packed) {
+            std::copy_n(_unpacked.get(), contracts.size(), result_ref().begin());
+          }
+          this->complete();
+        }
+      }
+
+      [[nodiscard]] ResultT result() override final {
+        return std::move(result_ref());
+      }
+
+      ResultT & result_ref() override final {
+        if (this->_destination != nullptr) {
+          return **this->_destination;
+        }
+        return _object;
+      }
+    };
+}
+
+namespace mr {
+  // Sequence assembled at runtime, e.g. from a config.
+  // Stages are checked to form a valid chain as they are added, an incomplete chain is rejected by `apply`.
+  // NOTE: stages must not be added while the prototype has applied tasks
+  template <typename In, typename Out>
+    struct DynamicSequence {
+      using InputT = In;
+      using OutputT = Out;
+      using TaskT = Task<OutputT>;
+      using TaskImplT = detail::DynSeqTaskImpl<InputT, OutputT>;
+
+      std::chrono::nanoseconds cost {};
+      std::vector<detail::ErasedStage> stages;
+
+      DynamicSequence() = default;
+
+      template <StageT ...StageTs>
+        DynamicSequence(StageTs ...s) {
+          stages.reserve(sizeof...(StageTs));
+          (push_back(std::move(s)), ...);
+        }
+
+      template <StageT S>
+        DynamicSequence & push_back(S stage) {
+          std::type_index expected = stages.empty() ? std::type_index(typeid(InputT)) : stages.back().output;
+          if (expected != typeid(input_t<S>)) {
+            throw std::invalid_argument("mr::DynamicSequence: invalid transform chain (type mismatch)");
+          }
+
+          cost += detail::estimate(stage);
+          stages.push_back(detail::erase_stage(std::move(stage)));
+          return *this;
+        }
+
+      // chain starts with `In` and ends with `Out`
+      bool complete() const noexcept {
+        return not stages.empty() && stages.back().output == typeid(OutputT);
+      }
+
+      size_t size() const noexcept {
+        return stages.size();
+      }
+    };
+
+  // Parallel of a runtime number of branches with the same signature,
+  // branch `i` takes element `i` of the input vector (which must have an element per branch)
+  template <typename In, typename Out>
+    struct DynamicParallel {
+      using InputT = std::vector<In>;
+      using OutputT = std::vector<Out>;
+      using TaskT = Task<OutputT>;
+      using TaskImplT = detail::DynParTaskImpl<InputT, OutputT>;
+
+      std::chrono::nanoseconds cost {};
+      std::vector<FunctionWrapper<Out(In &&)>> stages;
+      // NOTE: branches are type-erased below, so whether one is I/O-bound and resources of limited ones are kept aside
+      std::vector<bool> io;
+      std::vector<Resource> resources;
+
+      DynamicParallel() = default;
+
+      template <StageT ...StageTs>
+        DynamicParallel(StageTs ...s) {
+          stages.reserve(sizeof...(StageTs));
+          io.reserve(sizeof...(StageTs));
+          resources.reserve(sizeof...(StageTs));
+          (push_back(std::move(s)), ...);
+        }
+
+      template <StageT S>
+        DynamicParallel & push_back(S stage) {
+          static_assert(std::is_same_v<input_t<S>, In> && std::is_same_v<output_t<S>, Out>,
+            "Branch of mr::DynamicParallel must transform `In` into `Out`");
+
+          cost = std::max(cost, detail::estimate(stage));
+          io.push_back(is_io<S>);
+          resources.push_back(detail::resource_of(stage));
+          stages.push_back(detail::to_wrapper_v(std::move(stage)));
+          return *this;
+        }
+
+      size_t size() const noexcept {
+        return stages.size();
+      }
+    };
+}
+
+namespace mr::detail {
+  // one contract per stage, stored contiguously
+  template <typename In, typename Out>
+    void add_dynamic(DynSeqTaskImpl<In, Out> &task, const DynamicSequence<In, Out> &seq) {
+      if (not seq.complete()) {
+        throw std::invalid_argument("mr::DynamicSequence: chain does not produce the output type");
+      }
+
+      task.contracts.reserve(seq.size());
+      for (size_t i = 0; i < seq.size(); i++) {
+        task.contracts.push_back(Executor::get().create_contract(
+          [&task, stage = FunctionView<std::any(std::any &&)>(seq.stages[i].function), last = i + 1 == seq.size(), i]() mutable {
+            if (task.expired()) {
+              task.complete();
+              return;
+            }
+            group_slot = &no_group_slot;
+
+            task._object = stage(std::move(task._object));
+            if (not last) {
+              task.contracts[i + 1].schedule(task.deadline());
+            } else {
+              if (task._destination != nullptr) {
+                task._destination->emplace(std::move(*std::any_cast<Out>(&task._object)));
+              }
+              task.complete();
+            }
+          }
+        ));
+        if (seq.stages[i].io) {
+          task.contracts.back().route_to_io();
+        }
+        if (seq.stages[i].resource) {
+          task.contracts.back().limit(*seq.stages[i].resource.limiter());
+        }
+      }
+    }
+
+  template <typename In, typename Out>
+    void add_dynamic(DynParTaskImpl<std::vector<In>, std::vector<Out>> &task, const DynamicParallel<In, Out> &par) {
+      task.contracts.reserve(par.size());
+      for (size_t i = 0; i < par.size(); i++) {
+        task.contracts.push_back(Executor::get().create_contract(
+          [&task, stage = FunctionView<Out(In &&)>(par.stages[i]), i]() mutable {
+            if (not task.expired()) {
+              group_slot = &no_group_slot;
+              task.store(i, stage(std::move(task._input[i])));
+            }
+            task.arrive();
+          }
+        ));
+        if (par.io[i]) {
+          task.contracts.back().route_to_io();
+        }
+        if (par.resources[i]) {
+          task.contracts.back().limit(*par.resources[i].limiter());
+        }
+      }
+    }
+}
@@ -1,51 +1,1038 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
 #include <vector>
 #include <thread>
+#include <utility>
+
+#if defined(_WIN32)
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#elif defined(__linux__)
+#  include <pthread.h>
+#  include <sched.h>
+#endif
 
 #include "def.hpp"
+#include "backend.hpp"
+#include "incremental.hpp"
+#include "io.hpp"
 
 namespace mr {
+  struct Deadline {
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point at = Clock::time_point::max();
+    // stages of a task which is past its deadline are skipped (see `TaskState::missed`)
+    bool drop_missed = false;
+
+    bool none() const noexcept {
+      return at == Clock::time_point::max();
+    }
+  };
+
+  // what a worker does while there are no contracts
+  enum class IdlePolicy {
+    spin,  // polls the queues, the lowest latency
+    yield, // polls, yielding the core between attempts
+    park,  // sleeps until a contract is scheduled, takes no core while idle
+  };
+
+
+  struct TaskGroup;
+}
+
+namespace mr::detail {
+  struct Limiter;
+}
+
+namespace mr::detail {
+  // group of the stage which the calling thread runs (see `TaskGroup::current`),
+  // created on demand and kept by the task. Null outside of stages, cleared for every contract
+  inline thread_local std::unique_ptr<TaskGroup> *group_slot = nullptr;
+  // `group_slot` of stages of dynamic prototypes, which keep no groups
+  inline std::unique_ptr<TaskGroup> no_group_slot;
+
+  struct GroupScope {
+    explicit GroupScope(std::unique_ptr<TaskGroup> *slot) noexcept
+      : _previous(std::exchange(group_slot, slot))
+    {}
+
+    GroupScope(const GroupScope &) = delete;
+    GroupScope & operator=(const GroupScope &) = delete;
+
+    ~GroupScope() {
+      group_slot = _previous;
+    }
+
+  private:
+    std::unique_ptr<TaskGroup> *_previous;
+  };
+
+  // Contract of the work contract group, bound to one `Contract` at a time
+  // and returned to the executor's free list once that one is destroyed and the slot is idle.
+  // Whatever runs the contract (the group, the deadline heap, the `IoPool` or a backend) runs it through its slot,
+  // which merges repeated schedules the way a work contract does.
+  // NOTE: neighbouring slots are scheduled and run by different threads, so each one takes a cache line
+  struct alignas(cache_line_size) ContractSlot {
+    static constexpr std::uint32_t scheduled = 1;
+    static constexpr std::uint32_t running = 2;
+    static constexpr std::uint32_t released = 4; // the `Contract` is gone, its work must not be run
+
+    std::atomic<FunctionWrapper<void(void)> *> work = nullptr;
+    std::atomic<std::uint32_t> state = 0;
+    // routing of the bound contract
+    bool io = false;
+    Limiter *limiter = nullptr;
+    // handed to the deadline heap, the `IoPool` and backends, stays valid as long as the executor
+    FunctionWrapper<void(void)> run;
+    bcpp::work_contract contract;
+  };
+
+  // slot which the calling thread runs, nested ones (e.g. run while waiting for a task) form a chain
+  struct RunScope {
+    explicit RunScope(ContractSlot &slot) noexcept
+      : _slot(&slot)
+      , _outer(std::exchange(_innermost, this))
+    {}
+
+    RunScope(const RunScope &) = delete;
+    RunScope & operator=(const RunScope &) = delete;
+
+    ~RunScope() {
+      _innermost = _outer;
+    }
+
+    static bool runs(const ContractSlot &slot) noexcept {
+      for (auto *scope = _innermost; scope != nullptr; scope = scope->_outer) {
+        if (scope->_slot == &slot) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+  private:
+    inline static thread_local RunScope *_innermost = nullptr;
+
+    ContractSlot *_slot;
+    RunScope *_outer;
+  };
+}
+
+namespace mr {
+  // Unit of work of a task.
+  // Without a deadline it runs through the work contract group in its order,
+  // with one it is queued by the executor and served earliest deadline first.
+  // A slot of the group is taken by the first schedule and is recycled afterwards.
+  // Schedules before the contract ran are merged into one run, a schedule while it runs
+  // runs it once more afterwards (without a deadline), so a contract never runs twice at once.
+  // Contract of an I/O-bound stage is run by the `IoPool` instead, in submission order.
+  // Contract of a limited stage is deferred by its `Limiter` while the limit is reached.
+  // NOTE: a contract may be destroyed while it is scheduled (the pending run is dropped) and while it runs,
+  //       from another thread the destruction waits for the run to return
+  struct Contract {
+    Contract() = default;
+
+    explicit Contract(std::unique_ptr<FunctionWrapper<void(void)>> work) noexcept
+      : _work(std::move(work))
+    {}
+
+    Contract(Contract &&other) noexcept
+      : _work(std::move(other._work))
+      , _slot(other._slot.exchange(nullptr, std::memory_order_relaxed))
+      , _io(other._io)
+      , _limiter(other._limiter)
+    {}
+
+    Contract & operator=(Contract &&other) noexcept {
+      if (this != &other) {
+        release();
+        _work = std::move(other._work);
+        _slot.store(other._slot.exchange(nullptr, std::memory_order_relaxed), std::memory_order_relaxed);
+        _io = other._io;
+        _limiter = other._limiter;
+      }
+      return *this;
+    }
+
+    ~Contract() {
+      release();
+    }
+
+    void schedule();
+    void schedule(const Deadline &deadline);
+
+    // the contract is run by the `IoPool` from now on
+    void route_to_io() noexcept {
+      _io = true;
+    }
+
+    // the contract holds a permit of `limiter` while it runs from now on.
+    // NOTE: has to be called before the first schedule, as `route_to_io`
+    void limit(detail::Limiter &limiter) noexcept {
+      _limiter = &limiter;
+    }
+
+  private:
+    // slot of the contract, taken by the first schedule
+    detail::ContractSlot & bind();
+
+    void release() noexcept;
+
+    std::unique_ptr<FunctionWrapper<void(void)>> _work;
+    std::atomic<detail::ContractSlot *> _slot = nullptr;
+    bool _io = false;
+    detail::Limiter *_limiter = nullptr;
+  };
+
+  // Workers are started by the first contract scheduled to them (building prototypes and tasks does not start them),
+  // configure them before that with `configure`.
   struct Executor {
   public:
+    // default of `Config::threads`, read when the workers start unless `configure` or `thread_count` was called
     inline static int threadcount = std::thread::hardware_concurrency();
 
+    struct Config {
+      // with no threads contracts are only run by `run_pending`, `run_until` and threads waiting for tasks
+      int threads = threadcount;
+      IdlePolicy idle_policy = IdlePolicy::spin;
+      // CPUs the workers are pinned to, one by one in order of their start (round-robin), empty if they are not pinned.
+      // NOTE: only supported on Linux and Windows
+      std::vector<int> affinity {};
+    };
+
+    // bounds of elastic scaling
+    struct Elasticity {
+      int min_threads = 1;
+      int max_threads = threadcount;
+      // worker which found no contracts for this long retires
+      std::chrono::microseconds idle_timeout = std::chrono::milliseconds(50);
+      // minimal interval between two spawns while no worker is idle
+      std::chrono::microseconds spawn_interval = std::chrono::microseconds(200);
+    };
+
     bcpp::work_contract_group group;
-    std::vector<std::jthread> threads;
+
+    struct ContractUsage {
+      size_t capacity = 0; // slots taken from the work contract group
+      size_t used = 0;     // slots bound to live contracts, the rest is in the free list
+    };
 
     static Executor & get() noexcept {
       static Executor executor {};
       return executor;
     }
 
+    ~Executor() {
+      std::lock_guard lock(_workers_mutex);
+      for (auto &worker : _workers) {
+        worker->thread.request_stop();
+      }
+      unpark_all();
+      _workers.clear();
+    }
+
+    // takes effect right away if the workers already run (affinity only for the ones started afterwards).
+    // Throws `std::invalid_argument` (and changes nothing) if a CPU of `affinity` is not available to the process
+    void configure(Config config) {
+      for (int cpu : config.affinity) {
+        if (not cpu_available(cpu)) {
+          throw std::invalid_argument("mr::Executor::configure: affinity CPU " + std::to_string(cpu) + " is not available");
+        }
+      }
+
+      _idle_policy.store(config.idle_policy, std::memory_order_relaxed);
+      {
+        std::lock_guard lock(_workers_mutex);
+        _affinity = std::move(config.affinity);
+      }
+      thread_count(config.threads);
+      // parked workers keep sleeping otherwise
+      unpark_all();
+    }
+
+    // starts the workers unless they already run, called by the first schedule
+    void start() {
+      if (_started.load(std::memory_order_acquire)) {
+        return;
+      }
+      std::lock_guard lock(_workers_mutex);
+      if (not _started.load(std::memory_order_relaxed)) {
+        resize_locked(configured_threads());
+        _started.store(true, std::memory_order_release);
+      }
+    }
+
+    bool started() const noexcept {
+      return _started.load(std::memory_order_acquire);
+    }
+
+    // fixed pool size, disables elastic scaling.
+    // workers are added or retired one by one, so contracts in flight are not disturbed
     void thread_count(int n) {
-      if (n != thread_count()) {
+      _elastic.store(false, std::memory_order_relaxed);
+      _threads.store(n, std::memory_order_relaxed);
+      if (started()) {
         resize(n);
       }
     }
 
+    // workers which run, or will run once started
     int thread_count() const {
-      return threads.size();
+      if (not started()) {
+        return configured_threads();
+      }
+      return _active.load(std::memory_order_relaxed);
+    }
+
+    // worker threads which have not returned yet, retired ones included until they finish their current attempt
+    int live_threads() const {
+      std::lock_guard lock(_workers_mutex);
+      return static_cast<int>(std::ranges::count_if(_workers, [](const auto &worker) {
+        return not worker->finished.load(std::memory_order_acquire);
+      }));
+    }
+
+    // pool grows while all workers are busy and shrinks while they are idle
+    void elastic(Elasticity elasticity) {
+      _min_threads.store(elasticity.min_threads, std::memory_order_relaxed);
+      _max_threads.store(elasticity.max_threads, std::memory_order_relaxed);
+      _idle_timeout.store(elasticity.idle_timeout.count(), std::memory_order_relaxed);
+      _spawn_interval.store(elasticity.spawn_interval.count(), std::memory_order_relaxed);
+      _elastic.store(true, std::memory_order_release);
+      if (not started()) {
+        return;
+      }
+
+      auto active = thread_count();
+      if (active < elasticity.min_threads) {
+        resize(elasticity.min_threads);
+      } else if (active > elasticity.max_threads) {
+        resize(elasticity.max_threads);
+      }
+    }
+
+    template <typename F>
+      Contract create_contract(F &&work) {
+        auto wrapper = std::make_unique<FunctionWrapper<void(void)>>(
+          [this, work = std::forward<F>(work)]() mutable {
+            _executed++;
+            if (_idle_worker) {
+              _idle_worker = false;
+              _idle.fetch_sub(1, std::memory_order_relaxed);
+            }
+            // no idle worker is left to pick up the next contract
+            if (_elastic.load(std::memory_order_relaxed) && _idle.load(std::memory_order_relaxed) == 0) {
+              grow();
+            }
+            detail::NestedScope nested(nullptr);
+            detail::GroupScope group(nullptr);
+            work();
+          }
+        );
+        return Contract(std::move(wrapper));
+      }
+
+    // contracts are run by `backend` instead of the work contract group, deadlines are not taken into account then.
+    // Contracts of I/O-bound stages still go to the `IoPool`
+    // NOTE: backends must not be switched while tasks are in flight
+    template <ExecutorBackendT B>
+      void backend(B backend) {
+        auto impl = std::make_unique<detail::BackendImpl<B>>(std::move(backend));
+        _backend_ptr.store(impl.get(), std::memory_order_release);
+        _backend = std::move(impl);
+      }
+
+    // back to the work contract group
+    void default_backend() {
+      _backend_ptr.store(nullptr, std::memory_order_release);
+      _backend.reset();
+    }
+
+    // workers which could not be pinned to their CPU of `Config::affinity` and run unpinned
+    size_t pin_failures() const noexcept {
+      return _pin_failures.load(std::memory_order_relaxed);
+    }
+
+    ContractUsage contract_usage() {
+      std::lock_guard lock(_slots_mutex);
+      return {_slots.size(), _slots.size() - _free_slots.size()};
     }
 
+    // runs at most one pending contract on the calling thread,
+    // returns false if there was nothing to run
+    bool execute_next() {
+      if (auto *backend = _backend_ptr.load(std::memory_order_acquire)) {
+        return backend->execute_next();
+      }
+      return execute_own();
+    }
+
+    // deadline of the contract which is run by the calling thread,
+    // tasks scheduled from it without a deadline of their own inherit it
+    static const Deadline & current_deadline() noexcept {
+      return _current_deadline;
+    }
+
+    // the calling thread runs pending contracts until `done()` holds.
+    // After a while without any it sleeps until a contract is scheduled or `notify_waiters` is called,
+    // so threads blocked on long tasks take no core
+    template <typename PredicateT>
+      void help_until(PredicateT &&done) {
+        for (int misses = 0; not done();) {
+          if (execute_next()) {
+            misses = 0;
+          } else if (++misses > 64) {
+            sleep_until_work(done);
+            misses = 0;
+          }
+        }
+      }
+
+    // wakes up threads sleeping in `help_until`,
+    // has to be called by whatever makes their predicates hold (completions of tasks, groups and the like)
+    void notify_waiters() noexcept {
+      // NOTE: pairs with the fence of `sleep_until_work`, either the waiter sees the change or this sees the waiter
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (_waiting.load(std::memory_order_relaxed) > 0) {
+        _waiters_epoch.fetch_add(1, std::memory_order_release);
+        _waiters_epoch.notify_all();
+      }
+    }
+
+    // the calling thread (e.g. the main one, at a frame boundary) runs pending contracts
+    // until none is left or `budget` is spent, returns the number of contracts run.
+    // NOTE: a running contract is not interrupted, the budget is only checked between them
+    size_t run_pending(std::chrono::microseconds budget = std::chrono::microseconds::max()) {
+      using Clock = std::chrono::steady_clock;
+
+      auto until = budget == std::chrono::microseconds::max() ? Clock::time_point::max() : Clock::now() + budget;
+      size_t executed = 0;
+      while (execute_next()) {
+        executed++;
+        if (Clock::now() >= until) {
+          break;
+        }
+      }
+      return executed;
+    }
+
+    // the calling thread runs pending contracts until `task` (a `Task` or a `StaticTask`) is ready or `budget` is spent,
+    // returns whether the task is ready.
+    // NOTE: the task has to be scheduled already, without a budget a task which never was is waited for forever
+    template <typename TaskT>
+      bool run_until(const TaskT &task, std::chrono::microseconds budget = std::chrono::microseconds::max()) {
+        using Clock = std::chrono::steady_clock;
+
+        auto until = budget == std::chrono::microseconds::max() ? Clock::time_point::max() : Clock::now() + budget;
+        help_until([&task, until] { return task->is_ready() || (until != Clock::time_point::max() && Clock::now() >= until); });
+        return task->is_ready();
+      }
+
   private:
+    friend struct Contract;
+
+    friend struct detail::Limiter;
+
+    // NOTE: slots are taken once per contract lifetime, not per schedule, so a mutex is enough
+    detail::ContractSlot & acquire(FunctionWrapper<void(void)> &work, bool io, detail::Limiter *limiter) {
+      std::lock_guard lock(_slots_mutex);
+      detail::ContractSlot *slot;
+      if (_free_slots.empty()) {
+        slot = &_slots.emplace_back();
+        slot->run = [this, slot]() { run(*slot); };
+        slot->contract = group.create_contract([slot]() { slot->run(); });
+      } else {
+        // the most recently released slot, likely still in cache
+        slot = _free_slots.back();
+        _free_slots.pop_back();
+      }
+      slot->io = io;
+      slot->limiter = limiter;
+      slot->work.store(&work, std::memory_order_release);
+      return *slot;
+    }
+
+    // admits a slot which was idle and submits it, defined after `Limiter`
+    void dispatch(detail::ContractSlot &slot, const Deadline &deadline);
+
+    // hands an admitted slot over to whatever runs it.
+    // NOTE: I/O-bound contracts go to the `IoPool` whatever the backend
+    void submit(detail::ContractSlot &slot, const Deadline &deadline) {
+      if (slot.io) {
+        IoPool::get().submit(slot.run);
+        return;
+      }
+      if (auto *backend = _backend_ptr.load(std::memory_order_acquire)) {
+        backend->submit(slot.run);
+        // threads sleeping in `help_until` may run it through `execute_next`
+        notify_waiters();
+        return;
+      }
+      if (not deadline.none()) {
+        schedule(slot.run, deadline);
+        return;
+      }
+      start();
+      slot.contract.schedule();
+      unpark();
+    }
+
+    // NOTE: a slot is only bound again once no run of it is pending, which would run the work of the next `Contract`
+    void run(detail::ContractSlot &slot);
+
+    // the slot of a destroyed contract, recycled right away if it is idle and by its last run otherwise
+    void release(detail::ContractSlot &slot) noexcept {
+      using detail::ContractSlot;
+
+      auto state = slot.state.fetch_or(ContractSlot::released, std::memory_order_acq_rel);
+      if ((state & (ContractSlot::scheduled | ContractSlot::running)) == 0) {
+        recycle(slot);
+        return;
+      }
+      // NOTE: destroyed by another thread while it runs, the work has to return before it is freed.
+      //       A contract destroyed by its own run (or one nested into it) is not waited for
+      if ((state & ContractSlot::running) != 0 && not detail::RunScope::runs(slot)) {
+        while ((slot.state.load(std::memory_order_acquire) & ContractSlot::running) != 0) {
+          std::this_thread::yield();
+        }
+      }
+    }
+
+    void recycle(detail::ContractSlot &slot) noexcept {
+      slot.work.store(nullptr, std::memory_order_relaxed);
+      slot.state.store(0, std::memory_order_relaxed);
+      std::lock_guard lock(_slots_mutex);
+      _free_slots.push_back(&slot);
+    }
+
+    struct Urgent {
+      Deadline deadline;
+      FunctionWrapper<void(void)> *work;
+
+      // `std::push_heap` builds a max-heap, the earliest deadline has to be on top
+      bool operator<(const Urgent &other) const noexcept {
+        return deadline.at > other.deadline.at;
+      }
+    };
+
+    void schedule(FunctionWrapper<void(void)> &work, const Deadline &deadline) {
+      start();
+      bool first;
+      {
+        std::lock_guard lock(_urgent_mutex);
+        first = _urgent.empty();
+        _urgent.push_back({deadline, &work});
+        std::push_heap(_urgent.begin(), _urgent.end());
+      }
+      _urgent_size.fetch_add(1, std::memory_order_release);
+      // wakes up a worker which may be waiting inside the work contract group.
+      // NOTE: only needed once per non-empty heap, the woken worker checks the heap before the group every time
+      if (first) {
+        _wake.schedule();
+      }
+      unpark();
+    }
+
+    // runs at most one contract of the work contract group or one with a deadline
+    bool execute_own() {
+      auto executed = _executed;
+      if (not execute_urgent()) {
+        group.execute_next_contract();
+        // NOTE: the wake up contract and slots of destroyed contracts carry no work, somebody else may be behind them
+        while (std::exchange(_empty_run, false) && executed == _executed && not execute_urgent()) {
+          group.execute_next_contract();
+        }
+      }
+      return executed != _executed;
+    }
+
+    // runs the pending contract with the earliest deadline, if any
+    bool execute_urgent() {
+      if (_urgent_size.load(std::memory_order_acquire) == 0) {
+        return false;
+      }
+
+      Urgent next;
+      {
+        std::lock_guard lock(_urgent_mutex);
+        if (_urgent.empty()) {
+          return false;
+        }
+        std::pop_heap(_urgent.begin(), _urgent.end());
+        next = _urgent.back();
+        _urgent.pop_back();
+      }
+      _urgent_size.fetch_sub(1, std::memory_order_relaxed);
+
+      auto previous = std::exchange(_current_deadline, next.deadline);
+      (*next.work)();
+      _current_deadline = previous;
+      return true;
+    }
+
+    struct Worker {
+      std::jthread thread;
+      std::atomic<bool> leaving = false;  // no longer counted as active
+      std::atomic<bool> finished = false; // thread function returned, can be joined immediately
+    };
+
+    // contracts executed by the current thread, lets workers tell idle spins from useful ones
+    inline static thread_local size_t _executed = 0;
+    // true while the current thread is a worker counted in `_idle`
+    inline static thread_local bool _idle_worker = false;
+    inline static thread_local Deadline _current_deadline {};
+    // a contract without work (the wake up one or a released slot) was just run by the current thread
+    inline static thread_local bool _empty_run = false;
+
     void resize(int n) {
-      threads.clear();
-      threads.resize(n);
-      for (int i = 0; i < n; i++) {
-        threads[i] = std::jthread(
-          [this](const auto &token) {
-            while (not token.stop_requested()) {
-              group.execute_next_contract();
+      std::lock_guard lock(_workers_mutex);
+      resize_locked(n);
+    }
+
+    // NOTE: `_workers_mutex` has to be locked
+    void resize_locked(int n) {
+      while (_active.load(std::memory_order_relaxed) < n) {
+        spawn();
+      }
+      while (_active.load(std::memory_order_relaxed) > n) {
+        retire();
+      }
+    }
+
+    int configured_threads() const noexcept {
+      auto n = _threads.load(std::memory_order_relaxed);
+      if (n < 0) {
+        n = threadcount;
+      }
+      if (_elastic.load(std::memory_order_acquire)) {
+        n = std::clamp(n, _min_threads.load(std::memory_order_relaxed), _max_threads.load(std::memory_order_relaxed));
+      }
+      return n;
+    }
+
+    // wakes up a parked worker (and threads sleeping in `help_until`) after a contract was scheduled
+    void unpark() noexcept {
+      // NOTE: pairs with the fences of `park` and `sleep_until_work`,
+      //       either the sleeping thread finds the contract or this sees it sleeping
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (_idle_policy.load(std::memory_order_relaxed) == IdlePolicy::park && _parked.load(std::memory_order_relaxed) > 0) {
+        _epoch.fetch_add(1, std::memory_order_release);
+        _epoch.notify_one();
+      }
+      if (_waiting.load(std::memory_order_relaxed) > 0) {
+        _waiters_epoch.fetch_add(1, std::memory_order_release);
+        _waiters_epoch.notify_all();
+      }
+    }
+
+    void unpark_all() noexcept {
+      _epoch.fetch_add(1, std::memory_order_release);
+      _epoch.notify_all();
+    }
+
+    // sleeps until the next contract is scheduled, unless one is found right after announcing it
+    void park(const std::stop_token &token) {
+      auto epoch = _epoch.load(std::memory_order_acquire);
+      _parked.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (not token.stop_requested() && not execute_own()) {
+        _epoch.wait(epoch, std::memory_order_acquire);
+      }
+      _parked.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // sleeps until the next contract is scheduled or `notify_waiters` is called,
+    // unless `done()` holds or a contract is found right after announcing it
+    template <typename PredicateT>
+      void sleep_until_work(PredicateT &done) {
+        auto epoch = _waiters_epoch.load(std::memory_order_acquire);
+        _waiting.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (not done() && not execute_next()) {
+          _waiters_epoch.wait(epoch, std::memory_order_acquire);
+        }
+        _waiting.fetch_sub(1, std::memory_order_relaxed);
+      }
+
+    // true if the process may run on `cpu`, any index counts where pinning is not supported
+    static bool cpu_available(int cpu) noexcept {
+      if (cpu < 0) {
+        return false;
+      }
+#if defined(_WIN32)
+      DWORD_PTR process, system;
+      return cpu < static_cast<int>(8 * sizeof(DWORD_PTR)) &&
+             GetProcessAffinityMask(GetCurrentProcess(), &process, &system) && (process & (DWORD_PTR(1) << cpu)) != 0;
+#elif defined(__linux__)
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      return cpu < CPU_SETSIZE && sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_ISSET(cpu, &set);
+#else
+      return true;
+#endif
+    }
+
+    // NOTE: `_workers_mutex` has to be locked.
+    //       CPUs were checked by `configure`, a worker which still can not be pinned runs unpinned
+    void pin(std::jthread &thread) {
+      if (_affinity.empty()) {
+        return;
+      }
+      int cpu = _affinity[_pinned++ % _affinity.size()];
+      bool pinned = true;
+#if defined(_WIN32)
+      pinned = SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(__linux__)
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+      pinned = pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#else
+      (void)thread;
+      (void)cpu;
+#endif
+      if (not pinned) {
+        _pin_failures.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    // NOTE: `_workers_mutex` has to be locked
+    void spawn() {
+      _active.fetch_add(1, std::memory_order_relaxed);
+      _idle.fetch_add(1, std::memory_order_relaxed);
+
+      std::unique_ptr<Worker> *slot = nullptr;
+      for (auto &worker : _workers) {
+        if (worker->finished.load(std::memory_order_acquire)) {
+          worker->thread.join();
+          slot = &worker;
+          break;
+        }
+      }
+      if (slot == nullptr) {
+        slot = &_workers.emplace_back();
+      }
+
+      *slot = std::make_unique<Worker>();
+      auto &worker = **slot;
+      worker.thread = std::jthread(
+        [this, &worker](const std::stop_token &token) {
+          work(token, worker);
+          worker.finished.store(true, std::memory_order_release);
+        }
+      );
+      pin(worker.thread);
+    }
+
+    // NOTE: `_workers_mutex` has to be locked
+    void retire() {
+      for (auto it = _workers.rbegin(); it != _workers.rend(); ++it) {
+        auto &worker = **it;
+        if (not worker.leaving.load(std::memory_order_relaxed)) {
+          // the worker leaves after its current contract
+          worker.leaving.store(true, std::memory_order_relaxed);
+          worker.thread.request_stop();
+          _active.fetch_sub(1, std::memory_order_relaxed);
+          unpark_all();
+          return;
+        }
+      }
+    }
+
+    // called before a contract is run while no worker is idle
+    void grow() {
+      using Clock = std::chrono::steady_clock;
+
+      if (_active.load(std::memory_order_relaxed) >= _max_threads.load(std::memory_order_relaxed)) {
+        return;
+      }
+
+      std::unique_lock lock(_workers_mutex, std::try_to_lock);
+      if (not lock.owns_lock() ||
+          _idle.load(std::memory_order_relaxed) != 0 ||
+          _active.load(std::memory_order_relaxed) >= _max_threads.load(std::memory_order_relaxed)) {
+        return;
+      }
+
+      auto now = Clock::now();
+      if (now - _last_spawn > std::chrono::microseconds(_spawn_interval.load(std::memory_order_relaxed))) {
+        _last_spawn = now;
+        spawn();
+      }
+    }
+
+    // called by a worker which has been idle for a while, returns true if it has to leave
+    bool shrink(Worker &worker) {
+      std::unique_lock lock(_workers_mutex, std::try_to_lock);
+      if (lock.owns_lock() &&
+          not worker.leaving.load(std::memory_order_relaxed) &&
+          _active.load(std::memory_order_relaxed) > _min_threads.load(std::memory_order_relaxed)) {
+        worker.leaving.store(true, std::memory_order_relaxed);
+        _active.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+      return false;
+    }
+
+    void work(const std::stop_token &token, Worker &worker) {
+      using Clock = std::chrono::steady_clock;
+
+      // NOTE: `spawn` already counted this worker as idle
+      _idle_worker = true;
+      Clock::time_point idle_since = Clock::now();
+
+      // NOTE: workers keep serving the group, a custom backend runs contracts by itself
+      for (int misses = 0; not token.stop_requested();) {
+        if (execute_own()) {
+          misses = 0;
+          continue;
+        }
+
+        switch (_idle_policy.load(std::memory_order_relaxed)) {
+          case IdlePolicy::spin:
+            break;
+          case IdlePolicy::yield:
+            std::this_thread::yield();
+            break;
+          case IdlePolicy::park:
+            // NOTE: a parked worker is not retired by elastic scaling until it wakes up
+            if (++misses > 64) {
+              park(token);
+              misses = 0;
             }
+            break;
+        }
+
+        if (not _idle_worker) {
+          _idle_worker = true;
+          _idle.fetch_add(1, std::memory_order_relaxed);
+          idle_since = Clock::now();
+        } else if (_elastic.load(std::memory_order_relaxed) &&
+                   Clock::now() - idle_since > std::chrono::microseconds(_idle_timeout.load(std::memory_order_relaxed))) {
+          if (shrink(worker)) {
+            break;
           }
-        );
+          idle_since = Clock::now();
+        }
+      }
+
+      if (_idle_worker) {
+        _idle_worker = false;
+        _idle.fetch_sub(1, std::memory_order_relaxed);
       }
     }
 
     Executor() noexcept {
-      resize(threadcount);
+      _wake = group.create_contract([]() { _empty_run = true; });
     }
+
+    mutable std::mutex _workers_mutex;
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<int> _affinity;    // guarded by `_workers_mutex`
+    size_t _pinned = 0;            // guarded by `_workers_mutex`
+    std::atomic<size_t> _pin_failures = 0;
+
+    std::atomic<bool> _started = false;
+    std::atomic<int> _threads = -1; // `threadcount` until configured
+    std::atomic<IdlePolicy> _idle_policy = IdlePolicy::spin;
+
+    std::atomic<bool> _elastic = false;
+    std::atomic<int> _min_threads = 0;
+    std::atomic<int> _max_threads = 0;
+    std::atomic<std::chrono::microseconds::rep> _idle_timeout = 0;
+    std::atomic<std::chrono::microseconds::rep> _spawn_interval = 0;
+    std::chrono::steady_clock::time_point _last_spawn; // guarded by `_workers_mutex`
+
+    // NOTE: updated by workers on their own, kept apart from the settings read next to them
+    alignas(cache_line_size) std::atomic<int> _active = 0; // workers which are not leaving
+    std::atomic<int> _idle = 0;   // workers which did not find a contract on their last attempt
+    std::atomic<int> _parked = 0; // workers sleeping on `_epoch`
+    std::atomic<std::uint32_t> _epoch = 0;
+    std::atomic<int> _waiting = 0; // threads sleeping in `help_until` on `_waiters_epoch`
+    std::atomic<std::uint32_t> _waiters_epoch = 0;
+
+    // contracts scheduled with a deadline, a heap ordered by it
+    alignas(cache_line_size) std::mutex _urgent_mutex;
+    std::vector<Urgent> _urgent;
+    std::atomic<size_t> _urgent_size = 0;
+    bcpp::work_contract _wake;
+
+    // contracts of the group which are recycled between `Contract`s, addresses are stable
+    alignas(cache_line_size) std::mutex _slots_mutex;
+    std::deque<detail::ContractSlot> _slots;
+    std::vector<detail::ContractSlot *> _free_slots;
+
+    std::unique_ptr<detail::BackendBase> _backend;
+    std::atomic<detail::BackendBase *> _backend_ptr = nullptr;
   };
 }
 
+namespace mr::detail {
+  // Admits at most `limit` contracts at once, the rest waits in a queue instead of being scheduled,
+  // so deferred contracts take no worker. A finishing contract hands its permit over to the first waiting one.
+  // A permit is taken and given back once per run: schedules merged by the slot of a contract (see `ContractSlot`)
+  // take none, so a contract is never queued twice.
+  struct Limiter {
+    explicit Limiter(size_t limit) noexcept
+      : _limit(limit)
+    {}
+
+    Limiter(const Limiter &) = delete;
+    Limiter & operator=(const Limiter &) = delete;
+
+    // true if `slot` got a permit, otherwise it is submitted once it gets one.
+    // NOTE: called once per run of a contract, repeated schedules are merged by its slot before
+    bool admit(ContractSlot &slot, const Deadline &deadline) {
+      std::lock_guard lock(_mutex);
+      if (_active < _limit) {
+        _active++;
+        return true;
+      }
+      _deferred.push_back({&slot, deadline});
+      return false;
+    }
+
+    void release() {
+      Deferred next;
+      {
+        std::lock_guard lock(_mutex);
+        if (_deferred.empty() || _active > _limit) {
+          _active--;
+          return;
+        }
+        next = _deferred.front();
+        _deferred.pop_front();
+      }
+      Executor::get().submit(*next.slot, next.deadline);
+    }
+
+    // NOTE: a lower limit takes effect as running contracts finish
+    void limit(size_t limit) {
+      std::vector<Deferred> admitted;
+      {
+        std::lock_guard lock(_mutex);
+        _limit = limit;
+        while (_active < _limit && not _deferred.empty()) {
+          _active++;
+          admitted.push_back(_deferred.front());
+          _deferred.pop_front();
+        }
+      }
+      for (auto &next : admitted) {
+        Executor::get().submit(*next.slot, next.deadline);
+      }
+    }
+
+    size_t limit() const {
+      std::lock_guard lock(_mutex);
+      return _limit;
+    }
+
+    // contracts holding a permit
+    size_t active() const {
+      std::lock_guard lock(_mutex);
+      return _active;
+    }
+
+    // contracts waiting for a permit
+    size_t deferred() const {
+      std::lock_guard lock(_mutex);
+      return _deferred.size();
+    }
+
+  private:
+    struct Deferred {
+      ContractSlot *slot;
+      Deadline deadline;
+    };
+
+    mutable std::mutex _mutex;
+    size_t _limit;
+    size_t _active = 0;
+    std::deque<Deferred> _deferred;
+  };
+}
+
+namespace mr {
+  inline void Contract::schedule() {
+    schedule(Deadline {});
+  }
+
+  inline void Contract::schedule(const Deadline &deadline) {
+    auto &slot = bind();
+    // NOTE: a pending run takes this schedule as well, a running contract runs once more afterwards
+    auto state = slot.state.fetch_or(detail::ContractSlot::scheduled, std::memory_order_acq_rel);
+    if ((state & (detail::ContractSlot::scheduled | detail::ContractSlot::running)) == 0) {
+      Executor::get().dispatch(slot, deadline);
+    }
+  }
+
+  inline detail::ContractSlot & Contract::bind() {
+    auto *slot = _slot.load(std::memory_order_acquire);
+    if (slot == nullptr) {
+      auto &executor = Executor::get();
+      auto &fresh = executor.acquire(*_work, _io, _limiter);
+      // NOTE: contracts of a stream may be scheduled from several threads for the first time at once
+      if (_slot.compare_exchange_strong(slot, &fresh, std::memory_order_acq_rel)) {
+        slot = &fresh;
+      } else {
+        executor.release(fresh);
+      }
+    }
+    return *slot;
+  }
+
+  inline void Contract::release() noexcept {
+    if (auto *slot = _slot.exchange(nullptr, std::memory_order_acq_rel)) {
+      Executor::get().release(*slot);
+    }
+  }
+
+  inline void Executor::dispatch(detail::ContractSlot &slot, const Deadline &deadline) {
+    if (slot.limiter == nullptr || slot.limiter->admit(slot, deadline)) {
+      submit(slot, deadline);
+    }
+  }
+
+  inline void Executor::run(detail::ContractSlot &slot) {
+    using detail::ContractSlot;
+
+    auto state = slot.state.load(std::memory_order_acquire);
+    while (not slot.state.compare_exchange_weak(state, (state & ~ContractSlot::scheduled) | ContractSlot::running,
+                                                std::memory_order_acq_rel)) {
+    }
+    if ((state & ContractSlot::released) == 0) {
+      detail::RunScope scope(slot);
+      (*slot.work.load(std::memory_order_acquire))();
+    } else {
+      _empty_run = true;
+    }
+    // NOTE: a dropped run held a permit as well
+    if (slot.limiter != nullptr) {
+      slot.limiter->release();
+    }
+
+    // NOTE: the contract may be destroyed by its work, only the slot is used from here on
+    state = slot.state.fetch_and(~ContractSlot::running, std::memory_order_acq_rel);
+    if ((state & ContractSlot::released) != 0) {
+      recycle(slot);
+    } else if ((state & ContractSlot::scheduled) != 0) {
+      dispatch(slot, Deadline {});
+    }
+  }
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace mr {
+  // Input which carries its own version stamp, compared instead of the value itself
+  // to tell whether an incremental task can reuse the output computed from it
+  template <typename T>
+    concept VersionedT = requires (const T &value) {
+      { value.version() } -> std::equality_comparable;
+    };
+}
+
+namespace mr::detail {
+  // what is remembered about the input of a branch to detect that it did not change
+  template <typename T>
+    struct change_key {
+      using type = std::monostate; // nothing, the branch always runs
+      static constexpr bool comparable = false;
+    };
+
+  template <typename T> requires std::equality_comparable<T> && std::copy_constructible<T>
+    struct change_key<T> {
+      using type = T;
+      static constexpr bool comparable = true;
+
+      static const T & of(const T &input) noexcept {
+        return input;
+      }
+    };
+
+  template <VersionedT T>
+    struct change_key<T> {
+      using type = std::remove_cvref_t<decltype(std::declval<const T &>().version())>;
+      static constexpr bool comparable = true;
+
+      static type of(const T &input) {
+        return input.version();
+      }
+    };
+
+  // Output of a `Parallel` branch is kept between runs of an incremental task
+  // and reused while the branch's input is equal (or has the same version) to the one it was computed from
+  template <typename T>
+    struct BranchCache {
+      using KeyT = typename change_key<T>::type;
+
+      // true if the output of the previous run is still valid, otherwise the input is remembered
+      // (before the stage consumes it) and the output becomes valid once `commit` is called
+      bool hit(const T &input) {
+        if constexpr (change_key<T>::comparable) {
+          if (_valid.has_value() && *_valid == change_key<T>::of(input)) {
+            return true;
+          }
+          _valid.reset();
+          _pending.emplace(change_key<T>::of(input));
+        }
+        return false;
+      }
+
+      void commit() {
+        _valid = std::exchange(_pending, std::nullopt);
+      }
+
+      // output was moved out or not computed
+      void invalidate() noexcept {
+        _valid.reset();
+      }
+
+    private:
+      std::optional<KeyT> _valid;
+      std::optional<KeyT> _pending;
+    };
+
+  // caches of the branches of a `Parallel`, one per element of the input tuple
+  template <typename ...Ts>
+    struct TupleBranchCaches {
+      // called once per run, before the branches start
+      void observe(const std::tuple<Ts...> &) noexcept {}
+
+      template <size_t I>
+        bool hit(const std::tuple<Ts...> &input) {
+          return std::get<I>(_caches).hit(std::get<I>(input));
+        }
+
+      template <size_t I>
+        void commit() {
+          std::get<I>(_caches).commit();
+        }
+
+      void invalidate() noexcept {
+        std::apply([](auto &...caches) { (caches.invalidate(), ...); }, _caches);
+      }
+
+    private:
+      std::tuple<BranchCache<Ts>...> _caches;
+    };
+
+  template <typename InputT, size_t N> struct branch_caches;
+  template <typename ...Ts, size_t N>
+    struct branch_caches<std::tuple<Ts...>, N> {
+      using type = TupleBranchCaches<Ts...>;
+    };
+  template <typename InputT, size_t N> using branch_caches_t = typename branch_caches<InputT, N>::type;
+
+  // Nested prototype run by a stage of an incremental task (see `NestedTask`),
+  // kept by the task between runs so the nested caches survive as well
+  struct NestedBase {
+    virtual ~NestedBase() = default;
+  };
+
+  using NestedSlot = std::unique_ptr<NestedBase>;
+
+  // slot of the stage which the calling thread runs, null unless its task is incremental.
+  // cleared for every contract by the executor, consumed by the first nested prototype of the stage
+  inline thread_local NestedSlot *nested_slot = nullptr;
+
+  struct NestedScope {
+    explicit NestedScope(NestedSlot *slot) noexcept
+      : _previous(std::exchange(nested_slot, slot))
+    {}
+
+    NestedScope(const NestedScope &) = delete;
+    NestedScope & operator=(const NestedScope &) = delete;
+
+    ~NestedScope() {
+      nested_slot = _previous;
+    }
+
+  private:
+    NestedSlot *_previous;
+  };
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "def.hpp"
+
+namespace mr {
+  // Threads for stages which mostly wait (see `Io`), kept apart from the compute workers
+  // so a blocking read does not occupy one of them. Contracts are run in submission order,
+  // the stage which follows an I/O stage is scheduled on the compute executor again.
+  // Threads are started by the first I/O contract.
+  struct IoPool {
+    // blocked threads cost little, so there are more of them than compute workers
+    inline static int threadcount = 4 * std::max<int>(std::thread::hardware_concurrency(), 1);
+
+    static IoPool & get() noexcept {
+      static IoPool pool {};
+      return pool;
+    }
+
+    IoPool(const IoPool &) = delete;
+    IoPool & operator=(const IoPool &) = delete;
+
+    ~IoPool() {
+      std::lock_guard lock(_threads_mutex);
+      resize(0);
+    }
+
+    // NOTE: a retired thread finishes its current contract first, at least one thread is kept
+    void thread_count(int n) {
+      std::lock_guard lock(_threads_mutex);
+      resize(std::max(n, 1));
+    }
+
+    int thread_count() const {
+      std::lock_guard lock(_threads_mutex);
+      return static_cast<int>(_threads.size());
+    }
+
+    // true on threads of the pool
+    static bool is_io_thread() noexcept {
+      return _io_thread;
+    }
+
+    // NOTE: the slot of a contract merges its repeated schedules before (see `ContractSlot`),
+    //       so a contract is queued again only once its run returned and never runs on two threads at once
+    void submit(FunctionWrapper<void(void)> &work) {
+      if (not _started.load(std::memory_order_acquire)) {
+        start();
+      }
+      {
+        std::lock_guard lock(_queue_mutex);
+        _queue.push_back(&work);
+      }
+      _cv.notify_one();
+    }
+
+  private:
+    IoPool() = default;
+
+    void start() {
+      std::lock_guard lock(_threads_mutex);
+      if (not _started.load(std::memory_order_relaxed)) {
+        resize(std::max(threadcount, 1));
+      }
+    }
+
+    // NOTE: `_threads_mutex` has to be locked
+    void resize(int n) {
+      _started.store(true, std::memory_order_release);
+      while (static_cast<int>(_threads.size()) < n) {
+        _threads.emplace_back([this](const std::stop_token &token) { work(token); });
+      }
+      while (static_cast<int>(_threads.size()) > n) {
+        _threads.back().request_stop();
+        _cv.notify_all();
+        _threads.pop_back();
+      }
+    }
+
+    void work(const std::stop_token &token) {
+      _io_thread = true;
+      while (true) {
+        FunctionWrapper<void(void)> *work;
+        {
+          std::unique_lock lock(_queue_mutex);
+          if (not _cv.wait(lock, token, [this] { return not _queue.empty(); })) {
+            return;
+          }
+          work = _queue.front();
+          _queue.pop_front();
+        }
+        (*work)();
+      }
+    }
+
+    inline static thread_local bool _io_thread = false;
+
+    std::mutex _queue_mutex;
+    std::condition_variable_any _cv;
+    std::deque<FunctionWrapper<void(void)> *> _queue;
+
+    mutable std::mutex _threads_mutex;
+    std::atomic<bool> _started = false;
+    std::vector<std::jthread> _threads; // NOTE: joined first
+  };
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include "stages.hpp"
+
+namespace mr {
+  // Read-only memory mapping of a whole file, stages read it in place through `bytes()`.
+  // With `populate` the pages are read in by the constructor, so it is the mapping stage
+  // which blocks on the disk (on the `IoPool`, see `map_file`) and not the stage which reads it.
+  // Throws `std::system_error` if the file cannot be mapped.
+  struct MappedFile {
+    MappedFile() = default;
+
+    explicit MappedFile(const std::filesystem::path &path, bool populate = true) {
+      open(path, populate);
+    }
+
+    MappedFile(MappedFile &&other) noexcept
+      : _data(std::exchange(other._data, nullptr))
+      , _size(std::exchange(other._size, 0))
+    {}
+
+    MappedFile & operator=(MappedFile &&other) noexcept {
+      if (this != &other) {
+        close();
+        _data = std::exchange(other._data, nullptr);
+        _size = std::exchange(other._size, 0);
+      }
+      return *this;
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+      close();
+    }
+
+    std::span<const std::byte> bytes() const noexcept {
+      return {static_cast<const std::byte *>(_data), _size};
+    }
+
+    operator std::span<const std::byte>() const noexcept {
+      return bytes();
+    }
+
+    size_t size() const noexcept {
+      return _size;
+    }
+
+    bool empty() const noexcept {
+      return _size == 0;
+    }
+
+  private:
+#ifdef _WIN32
+    void open(const std::filesystem::path &path, bool populate) {
+      HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+      if (file == INVALID_HANDLE_VALUE) {
+        throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "mr::MappedFile: open");
+      }
+
+      LARGE_INTEGER size;
+      if (not GetFileSizeEx(file, &size)) {
+        auto error = GetLastError();
+        CloseHandle(file);
+        throw std::system_error(static_cast<int>(error), std::system_category(), "mr::MappedFile: size");
+      }
+      // NOTE: empty files cannot be mapped, they are represented by an empty span
+      if (size.QuadPart == 0) {
+        CloseHandle(file);
+        return;
+      }
+
+      HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      CloseHandle(file);
+      if (mapping == nullptr) {
+        throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "mr::MappedFile: map");
+      }
+      _data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+      if (_data == nullptr) {
+        throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "mr::MappedFile: map");
+      }
+      _size = static_cast<size_t>(size.QuadPart);
+
+      if (populate) {
+        WIN32_MEMORY_RANGE_ENTRY range {_data, _size};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+        touch();
+      }
+    }
+
+    void close() noexcept {
+      if (_data != nullptr) {
+        UnmapViewOfFile(_data);
+        _data = nullptr;
+        _size = 0;
+      }
+    }
+#else
+    void open(const std::filesystem::path &path, bool populate) {
+      int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "mr::MappedFile: open");
+      }
+
+      struct stat info;
+      if (::fstat(fd, &info) != 0) {
+        auto error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "mr::MappedFile: stat");
+      }
+      // NOTE: empty files cannot be mapped, they are represented by an empty span
+      if (info.st_size == 0) {
+        ::close(fd);
+        return;
+      }
+
+      int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+      if (populate) {
+        flags |= MAP_POPULATE;
+      }
+#endif
+      void *data = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, flags, fd, 0);
+      auto error = errno;
+      ::close(fd); // the mapping keeps the file
+      if (data == MAP_FAILED) {
+        throw std::system_error(error, std::generic_category(), "mr::MappedFile: mmap");
+      }
+      _data = data;
+      _size = static_cast<size_t>(info.st_size);
+
+#ifndef MAP_POPULATE
+      if (populate) {
+        ::madvise(_data, _size, MADV_WILLNEED);
+        touch();
+      }
+#endif
+    }
+
+    void close() noexcept {
+      if (_data != nullptr) {
+        ::munmap(_data, _size);
+        _data = nullptr;
+        _size = 0;
+      }
+    }
+#endif
+
+    // faults every page in, where the system cannot populate the mapping by itself
+    [[maybe_unused]] void touch() const noexcept {
+      constexpr size_t page = 4096;
+      auto *bytes = static_cast<const volatile std::byte *>(_data);
+      for (size_t i = 0; i < _size; i += page) {
+        (void)bytes[i];
+      }
+    }
+
+    void *_data = nullptr;
+    size_t _size = 0;
+  };
+
+  // source stage: maps (and reads in) the file at a path on the `IoPool`,
+  // the next stage gets the mapping and reads it without a copy
+  struct MapFile {
+    bool populate = true;
+
+    MappedFile operator()(const std::filesystem::path &path) const {
+      return MappedFile(path, populate);
+    }
+  };
+
+  inline constexpr Io map_file {MapFile {}};
+}
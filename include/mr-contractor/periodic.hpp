@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "mr-contractor/def.hpp"
+#include "mr-contractor/executor.hpp"
+#include "task.hpp"
+
+namespace mr {
+  struct PeriodicStats {
+    size_t runs = 0;     // started runs
+    size_t overruns = 0; // ticks skipped because the previous run was still in flight
+    // delay between a tick of the timer and the scheduling of its run.
+    // NOTE: runs started by `signal()` are scheduled by the signalling thread right away, they are not counted
+    std::chrono::nanoseconds jitter_mean {};
+    std::chrono::nanoseconds jitter_max {};
+  };
+
+  // Reschedules one applied task at a fixed period or on every external `signal()`.
+  // The same task state is reused by every run and nobody blocks on it:
+  // the run is started without waiting and `on_result` is called by the contract which completes it.
+  // A tick which finds the previous run still in flight is skipped and counted as an overrun.
+  // NOTE: task has to outlive the periodic execution
+  template <typename ResultT>
+    struct Periodic {
+      using Clock = std::chrono::steady_clock;
+      using ResultCallbackT = FunctionWrapper<void(ResultT &)>;
+
+      // runs are started by `signal()`
+      Periodic(Task<ResultT> &task, ResultCallbackT on_result = {})
+        : _task(*task)
+        , _on_result(std::move(on_result))
+      {
+        _listener.on_complete = [this]() noexcept { finished(); };
+      }
+
+      // runs are started every `period` by a timer thread
+      Periodic(Task<ResultT> &task, std::chrono::nanoseconds period, ResultCallbackT on_result = {})
+        : Periodic(task, std::move(on_result))
+      {
+        _timer = std::jthread(
+          [this, period](const std::stop_token &token) { tick(token, period); }
+        );
+      }
+
+      Periodic(const Periodic &) = delete;
+      Periodic & operator=(const Periodic &) = delete;
+
+      ~Periodic() {
+        stop();
+      }
+
+      // external frame signal, returns false if the previous run is still in flight
+      bool signal() {
+        return start(std::nullopt);
+      }
+
+      // no more runs are started, the one in flight is waited for
+      void stop() {
+        if (_timer.joinable()) {
+          _timer.request_stop();
+          _timer.join();
+        }
+        wait();
+      }
+
+      // waits for the run in flight, if any
+      void wait() {
+        Executor::get().help_until([this] { return not _in_flight.load(std::memory_order_acquire); });
+      }
+
+      PeriodicStats stats() const {
+        std::lock_guard lock(_stats_mutex);
+        PeriodicStats res = _stats;
+        res.overruns = _overruns.load(std::memory_order_relaxed);
+        if (_ticked_runs != 0) {
+          res.jitter_mean = _jitter_sum / _ticked_runs;
+        }
+        return res;
+      }
+
+    private:
+      // `tick` is the intended start of a timer-driven run
+      bool start(std::optional<Clock::time_point> tick) {
+        if (_in_flight.exchange(true, std::memory_order_acq_rel)) {
+          _overruns.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        }
+
+        {
+          std::lock_guard lock(_stats_mutex);
+          _stats.runs++;
+          if (tick.has_value()) {
+            auto jitter = std::max(Clock::now() - *tick, Clock::duration::zero());
+            _ticked_runs++;
+            _jitter_sum += jitter;
+            _stats.jitter_max = std::max<std::chrono::nanoseconds>(_stats.jitter_max, jitter);
+          }
+        }
+
+        _listener.remaining.store(1, std::memory_order_relaxed);
+        _task.schedule();
+        _task.listen(_listener, 0);
+        return true;
+      }
+
+      // called by the contract which completes the run
+      void finished() noexcept {
+        if (_on_result) {
+          _on_result(_task.result_ref());
+        }
+        _in_flight.store(false, std::memory_order_release);
+      }
+
+      void tick(const std::stop_token &token, std::chrono::nanoseconds period) {
+        std::mutex mutex;
+        std::condition_variable_any cv;
+
+        auto next = Clock::now();
+        while (not token.stop_requested()) {
+          start(next);
+
+          next += period;
+          // NOTE: ticks which the timer itself was too late for are not made up
+          if (auto now = Clock::now(); next < now) {
+            next += (now - next) / period * period + period;
+          }
+
+          std::unique_lock lock(mutex);
+          cv.wait_until(lock, token, next, [] { return false; });
+        }
+      }
+
+      detail::TaskBase<ResultT> &_task;
+      ResultCallbackT _on_result;
+      detail::CompletionListener _listener {1};
+
+      std::atomic<bool> _in_flight = false;
+      std::atomic<size_t> _overruns = 0;
+
+      mutable std::mutex _stats_mutex;
+      PeriodicStats _stats;
+      std::chrono::nanoseconds _jitter_sum {};
+      size_t _ticked_runs = 0;
+
+      std::jthread _timer;
+    };
+
+  template <typename ResultT, typename ...ArgTs>
+    Periodic(Task<ResultT> &, ArgTs &&...) -> Periodic<ResultT>;
+}
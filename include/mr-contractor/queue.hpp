@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+
+#include "def.hpp"
+
+namespace mr::detail {
+  // Bounded lock-free multi-producer/multi-consumer queue (D. Vyukov's design).
+  // Every cell carries a sequence number telling whether it is ready to be written or read,
+  // so producers and consumers only contend on their own position counter.
+  template <typename T>
+    struct BoundedQueue {
+      explicit BoundedQueue(size_t capacity)
+        : _mask(std::bit_ceil(capacity < 2 ? 2 : capacity) - 1)
+        , _cells(std::make_unique<Cell[]>(_mask + 1))
+      {
+        for (size_t i = 0; i <= _mask; i++) {
+          _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+      }
+
+      BoundedQueue(const BoundedQueue &) = delete;
+      BoundedQueue & operator=(const BoundedQueue &) = delete;
+
+      ~BoundedQueue() {
+        while (try_pop().has_value()) {}
+      }
+
+      // `value` is only consumed if there was room for it
+      template <typename U>
+        bool try_push(U &&value) {
+          size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+          Cell *cell;
+          while (true) {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+              if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+              }
+            } else if (diff < 0) {
+              return false; // full
+            } else {
+              pos = _enqueue_pos.load(std::memory_order_relaxed);
+            }
+          }
+
+          std::construct_at(cell->value(), std::forward<U>(value));
+          cell->sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+
+      std::optional<T> try_pop() {
+        size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+          cell = &_cells[pos & _mask];
+          size_t seq = cell->sequence.load(std::memory_order_acquire);
+          auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+          if (diff == 0) {
+            if (_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+              break;
+            }
+          } else if (diff < 0) {
+            return std::nullopt; // empty
+          } else {
+            pos = _dequeue_pos.load(std::memory_order_relaxed);
+          }
+        }
+
+        std::optional<T> result(std::move(*cell->value()));
+        std::destroy_at(cell->value());
+        cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+        return result;
+      }
+
+      // NOTE: only a snapshot, may be outdated by the time it is used
+      bool empty() const noexcept {
+        size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+        size_t seq = _cells[pos & _mask].sequence.load(std::memory_order_acquire);
+        return static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1) < 0;
+      }
+
+      size_t capacity() const noexcept {
+        return _mask + 1;
+      }
+
+    private:
+      struct Cell {
+        std::atomic<size_t> sequence;
+        alignas(T) std::byte storage[sizeof(T)];
+
+        T * value() noexcept { return std::launder(reinterpret_cast<T *>(storage)); }
+      };
+
+      const size_t _mask;
+      std::unique_ptr<Cell[]> _cells;
+
+      alignas(cache_line_size) std::atomic<size_t> _enqueue_pos {0};
+      alignas(cache_line_size) std::atomic<size_t> _dequeue_pos {0};
+    };
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "mr-contractor/def.hpp"
+#include "mr-contractor/executor.hpp"
+#include "stages.hpp"
+#include "task.hpp"
+#include "apply.hpp"
+
+namespace mr {
+  // One applied prototype serving many simultaneous executions.
+  // Each execution borrows a slot (its input and task state) from a ring which
+  // is filled once on construction, so no contracts are created per request.
+  // NOTE: stages are invoked concurrently from different slots,
+  //       so user callables must be safe to call from several threads at once
+  template <ApplicableT S>
+    struct ReentrantTask {
+      using InputT = typename S::InputT;
+      using OutputT = typename S::OutputT;
+
+      struct Slot {
+        // NOTE: empty between executions, so `InputT` does not have to be default constructible
+        std::optional<InputT> _input;
+        Task<OutputT> _task;
+        std::atomic_flag _busy {};
+      };
+
+      // handle to a single in-flight execution, gives its slot back on destruction
+      struct Execution {
+        Execution() = default;
+        Execution(ReentrantTask *owner, Slot *slot) : _owner(owner), _slot(slot) {}
+
+        Execution(const Execution &) = delete;
+        Execution & operator=(const Execution &) = delete;
+
+        Execution(Execution &&other) noexcept
+          : _owner(std::exchange(other._owner, nullptr))
+          , _slot(std::exchange(other._slot, nullptr))
+          , _waited(std::exchange(other._waited, false))
+        {}
+        Execution & operator=(Execution &&other) noexcept {
+          if (this != &other) {
+            reset();
+            _owner = std::exchange(other._owner, nullptr);
+            _slot = std::exchange(other._slot, nullptr);
+            _waited = std::exchange(other._waited, false);
+          }
+          return *this;
+        }
+
+        ~Execution() { reset(); }
+
+        Execution & wait() {
+          if (not _waited) {
+            _slot->_task->wait();
+            _waited = true;
+          }
+          return *this;
+        }
+
+        // waits for the execution unless it was waited for already
+        [[nodiscard]] OutputT result() {
+          return wait()._slot->_task->result();
+        }
+
+      private:
+        void reset() {
+          if (_slot != nullptr) {
+            // slot can only be reused once the execution that owns it is done
+            wait();
+            _owner->release(*_slot);
+            _slot = nullptr;
+          }
+        }
+
+        ReentrantTask *_owner = nullptr;
+        Slot *_slot = nullptr;
+        bool _waited = false;
+      };
+
+      ReentrantTask(const S &stage, size_t size)
+        : _slots(std::make_unique<Slot[]>(size))
+        , _size(size)
+      {
+        for (size_t i = 0; i < _size; i++) {
+          Slot &slot = _slots[i];
+          slot._task = mr::apply(stage, [&slot]() -> InputT {
+            InputT input = std::move(*slot._input);
+            slot._input.reset();
+            return input;
+          });
+        }
+      }
+
+      ReentrantTask(const ReentrantTask &) = delete;
+      ReentrantTask & operator=(const ReentrantTask &) = delete;
+
+      // blocks while every slot of the ring is in flight
+      Execution schedule(InputT input) {
+        Slot *slot = nullptr;
+        while (true) {
+          auto released = _released.load(std::memory_order_acquire);
+          if ((slot = try_acquire()) != nullptr) {
+            break;
+          }
+          _released.wait(released, std::memory_order_acquire);
+        }
+        return start(*slot, std::move(input));
+      }
+
+      // does not block, returns std::nullopt if every slot of the ring is in flight
+      std::optional<Execution> try_schedule(InputT input) {
+        if (Slot *slot = try_acquire(); slot != nullptr) {
+          return start(*slot, std::move(input));
+        }
+        return std::nullopt;
+      }
+
+      Execution execute(InputT input) {
+        auto execution = schedule(std::move(input));
+        execution.wait();
+        return execution;
+      }
+
+      size_t size() const noexcept {
+        return _size;
+      }
+
+    private:
+      Slot * try_acquire() noexcept {
+        for (size_t i = 0; i < _size; i++) {
+          Slot &slot = _slots[_cursor.fetch_add(1, std::memory_order_relaxed) % _size];
+          if (not slot._busy.test_and_set(std::memory_order_acquire)) {
+            return &slot;
+          }
+        }
+        return nullptr;
+      }
+
+      Execution start(Slot &slot, InputT input) {
+        slot._input.emplace(std::move(input));
+        slot._task->schedule();
+        return Execution(this, &slot);
+      }
+
+      void release(Slot &slot) noexcept {
+        slot._busy.clear(std::memory_order_release);
+        _released.fetch_add(1, std::memory_order_release);
+        _released.notify_one();
+      }
+
+      std::unique_ptr<Slot[]> _slots;
+      size_t _size;
+
+      std::atomic<size_t> _cursor {0};
+      std::atomic<size_t> _released {0};
+    };
+
+  template <ApplicableT S>
+    ReentrantTask<S> apply_reentrant(const S &stage, size_t size = Executor::threadcount) {
+      return ReentrantTask<S>(stage, size);
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "executor.hpp"
+
+namespace mr {
+  // Class of stages which share a limited resource (a connection pool, a memory-hungry decoder):
+  // at most `limit` of their contracts run at once, across all tasks (see `Limited`).
+  // Copies refer to the same class, a default constructed one is unlimited
+  struct Resource {
+    Resource() = default;
+
+    Resource(size_t limit)
+      : _limiter(std::make_shared<detail::Limiter>(limit))
+    {}
+
+    // class registered under `name`, created with `limit` by the first call.
+    // NOTE: later calls do not change the limit, use `limit(n)` for that
+    static Resource named(std::string_view name, size_t limit) {
+      static std::mutex mutex;
+      static std::map<std::string, Resource, std::less<>> registry;
+
+      std::lock_guard lock(mutex);
+      auto it = registry.find(name);
+      if (it == registry.end()) {
+        it = registry.emplace(std::string(name), Resource(limit)).first;
+      }
+      return it->second;
+    }
+
+    // deferred contracts are admitted right away if the limit grows
+    void limit(size_t limit) {
+      _limiter->limit(limit);
+    }
+
+    size_t limit() const {
+      return _limiter->limit();
+    }
+
+    // contracts of the class which run now
+    size_t active() const {
+      return _limiter->active();
+    }
+
+    // contracts of the class which wait to be admitted
+    size_t deferred() const {
+      return _limiter->deferred();
+    }
+
+    explicit operator bool() const noexcept {
+      return _limiter != nullptr;
+    }
+
+    detail::Limiter * limiter() const noexcept {
+      return _limiter.get();
+    }
+
+  private:
+    std::shared_ptr<detail::Limiter> _limiter;
+  };
+}
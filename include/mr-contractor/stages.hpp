@@ -1,6 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
 #include "def.hpp"
+#include "resource.hpp"
 #include "traits.hpp"
 #include "task.hpp"
 
@@ -9,9 +17,10 @@ namespace mr::detail {
     struct to_wrapper {
       using type = T;
     };
+  // NOTE: wrappers take their input by rvalue reference, so it is moved only by the stage itself
   template <Callable T>
     struct to_wrapper<T> {
-      using type = FunctionWrapper<output_t<T>(input_t<T>)>;
+      using type = FunctionWrapper<output_t<T>(input_t<T> &&)>;
     };
   template <typename T> using to_wrapper_t = to_wrapper<T>::type;
   template <typename T> to_wrapper_t<T> to_wrapper_v(T &&stage);
@@ -22,7 +31,7 @@ namespace mr::detail {
     };
   template <Callable T>
     struct to_wrapper_view<T> {
-      using type = FunctionView<output_t<T>(input_t<T>)>;
+      using type = FunctionView<output_t<T>(input_t<T> &&)>;
     };
   template <typename T> using to_wrapper_view_t = to_wrapper_view<T>::type;
   template <typename T> to_wrapper_view_t<T> to_wrapper_view_v(const T &v) { return v; }
@@ -31,6 +40,7 @@ namespace mr::detail {
 namespace mr {
   template <typename ...> struct Sequence { static_assert(false, "ERROR: Some of the stages do not satisfy mr::StageT concept"); };
   template <typename ...> struct Parallel { static_assert(false, "ERROR: Some of the stages do not satisfy mr::StageT concept"); };
+  template <typename ...> struct Broadcast { static_assert(false, "ERROR: Some of the stages do not satisfy mr::StageT concept"); };
 
   template <typename T> constexpr bool is_sequence = false;
   template <typename ...Us> constexpr bool is_sequence<Sequence<Us...>> = true;
@@ -40,18 +50,155 @@ namespace mr {
   template <typename ...Us> constexpr bool is_parallel<Parallel<Us...>> = true;
   template <typename T> concept ParallelT = is_parallel<T>;
 
-  template <typename T> concept ApplicableT = ParallelT<T> || SequenceT<T>;
+  template <typename T> constexpr bool is_broadcast = false;
+  template <typename ...Us> constexpr bool is_broadcast<Broadcast<Us...>> = true;
+  template <typename T> concept BroadcastT = is_broadcast<T>;
+
+  // runtime-composed counterparts (see dynamic.hpp)
+  template <typename In, typename Out> struct DynamicSequence;
+  template <typename In, typename Out> struct DynamicParallel;
+
+  template <typename T> constexpr bool is_dynamic = false;
+  template <typename In, typename Out> constexpr bool is_dynamic<DynamicSequence<In, Out>> = true;
+  template <typename In, typename Out> constexpr bool is_dynamic<DynamicParallel<In, Out>> = true;
+  template <typename T> concept DynamicT = is_dynamic<T>;
+
+  template <typename In, typename Out>
+    struct CallableTraits<DynamicSequence<In, Out>> : details::InputTOutputT<In, Out> {};
+
+  template <typename In, typename Out>
+    struct CallableTraits<DynamicParallel<In, Out>> : details::InputTOutputT<std::vector<In>, std::vector<Out>> {};
+
+  template <typename T> concept ApplicableT = ParallelT<T> || SequenceT<T> || BroadcastT<T> || DynamicT<T>;
 
   template <typename T> constexpr bool is_stage_reference = false;
   template <ApplicableT T> constexpr bool is_stage_reference<std::reference_wrapper<T>> = true;
   template <typename T> concept ApplicableRefT = is_stage_reference<T>;
 
-  template <typename T> concept StageT = Callable<T> || ApplicableT<T> || ApplicableRefT<T>;
+  // Decorators wrap a stage and only add information about how it is scheduled
+  template <typename T> constexpr bool is_decorator = false;
+  template <typename T> concept DecoratorT = is_decorator<T>;
+
+  template <typename T> concept StageT = Callable<T> || ApplicableT<T> || ApplicableRefT<T> || DecoratorT<T>;
+
+  // Expected execution time of a stage.
+  // Costs add up along a `Sequence` and the most expensive branch defines the cost of a `Parallel`,
+  // whose branches start in critical path order (estimates are refined by measured times)
+  template <typename S>
+    struct Estimated {
+      S stage;
+      std::chrono::nanoseconds cost;
+    };
+
+  template <typename S>
+    Estimated(S, std::chrono::nanoseconds) -> Estimated<S>;
+
+  template <typename S> constexpr bool is_decorator<Estimated<S>> = true;
+
+  template <typename S>
+    struct CallableTraits<Estimated<S>> : CallableTraits<S> {};
+
+  // Stage which mostly waits (blocking reads, network), its contract runs on the `IoPool`
+  // and the stage after it is handed back to the compute executor
+  template <typename S>
+    struct Io {
+      S stage;
+    };
+
+  template <typename S>
+    Io(S) -> Io<S>;
+
+  template <typename S> constexpr bool is_decorator<Io<S>> = true;
+
+  template <typename S>
+    struct CallableTraits<Io<S>> : CallableTraits<S> {};
+
+  // Stage of which at most `resource.limit()` contracts run at once, across all tasks of the prototype
+  // (and across all stages of the same `Resource`). Contracts above the limit are deferred until a running one
+  // finishes, other stages keep running meanwhile: `Limited{decode, 2}`, `Limited{query, Resource::named("db", 8)}`.
+  // NOTE: a limited stage must not wait for a nested prototype which needs a permit of its own resource
+  template <typename S>
+    struct Limited {
+      S stage;
+      Resource resource;
+    };
+
+  template <typename S>
+    Limited(S, Resource) -> Limited<S>;
+  template <typename S>
+    Limited(S, size_t) -> Limited<S>;
+
+  template <typename S> constexpr bool is_decorator<Limited<S>> = true;
+
+  template <typename S>
+    struct CallableTraits<Limited<S>> : CallableTraits<S> {};
+
+  template <typename T> constexpr bool is_limited = false;
+  template <typename S> constexpr bool is_limited<Limited<S>> = true;
+  template <typename S> constexpr bool is_limited<Estimated<S>> = is_limited<S>;
+  template <typename S> constexpr bool is_limited<Io<S>> = is_limited<S>;
+  template <typename T> concept LimitedT = is_limited<T>;
+
+  // true if the stage is I/O-bound, also under other decorators
+  template <typename T> constexpr bool is_io = false;
+  template <typename S> constexpr bool is_io<Io<S>> = true;
+  template <typename S> constexpr bool is_io<Estimated<S>> = is_io<S>;
+  template <typename S> constexpr bool is_io<Limited<S>> = is_io<S>;
+  template <typename T> concept IoT = is_io<T>;
 
   namespace detail {
+    template <typename S>
+      struct to_wrapper<Estimated<S>> {
+        using type = typename to_wrapper<S>::type;
+      };
+
+    template <typename S>
+      struct to_wrapper<Io<S>> {
+        using type = typename to_wrapper<S>::type;
+      };
+
+    template <typename S>
+      struct to_wrapper<Limited<S>> {
+        using type = typename to_wrapper<S>::type;
+      };
+
+    template <typename S>
+      Resource resource_of(const Limited<S> &stage) {
+        return stage.resource;
+      }
+
+    // resource of a limited stage, an unlimited one otherwise
+    template <typename T>
+      Resource resource_of(const T &stage) {
+        if constexpr (DecoratorT<T>) {
+          return resource_of(stage.stage);
+        } else {
+          return {};
+        }
+      }
+
+    template <typename S>
+      constexpr std::chrono::nanoseconds estimate(const Estimated<S> &stage) {
+        return stage.cost;
+      }
+
+    // estimated cost of the critical path through a stage, zero if unknown
+    template <typename T>
+      constexpr std::chrono::nanoseconds estimate(const T &stage) {
+        if constexpr (ApplicableT<T>) {
+          return stage.cost;
+        } else if constexpr (ApplicableRefT<T>) {
+          return stage.get().cost;
+        } else if constexpr (DecoratorT<T>) {
+          return estimate(stage.stage);
+        } else {
+          return std::chrono::nanoseconds::zero();
+        }
+      }
+
     template <ApplicableT T>
       struct to_wrapper<T> {
-        using type = FunctionWrapper<typename T::OutputT(typename T::InputT)>;
+        using type = FunctionWrapper<typename T::OutputT(typename T::InputT &&)>;
       };
 
     template <ApplicableT T>
@@ -67,14 +214,25 @@ namespace mr {
       // for external use
       using InputT = mr::to_tuple_t<input_t<StageTs>...>;
       using OutputT = mr::to_tuple_t<output_t<StageTs>...>;
-      using VariantT = mr::to_variant_t<input_t<StageTs>..., output_t<StageTs>...>;
-      using TupleT = mr::to_tuple_t<mr::detail::to_wrapper_t<StageTs>...>;
+      using TupleT = mr::detail::flat_tuple<mr::detail::to_wrapper_t<StageTs>...>;
 
       using TaskT = Task<OutputT>;
       using TaskImplT = detail::ParTaskImpl<sizeof...(StageTs), InputT, OutputT>;
 
+      static constexpr size_t size = sizeof...(StageTs);
+      static constexpr std::array<bool, size> io {is_io<StageTs>...};
+
+      std::chrono::nanoseconds cost;
+      std::unique_ptr<detail::CostModel<size>> cost_model;
+      // NOTE: stages are type-erased below, so resources of limited ones are kept aside
+      std::array<Resource, size> resources;
       TupleT stages;
-      constexpr Parallel(StageTs... s) : stages(std::forward_as_tuple(detail::to_wrapper_v(std::move(s))...)) {}
+      constexpr Parallel(StageTs... s)
+        : cost(std::max({detail::estimate(s)...}))
+        , cost_model(std::make_unique<detail::CostModel<size>>(std::array{detail::estimate(s)...}))
+        , resources {detail::resource_of(s)...}
+        , stages(detail::to_wrapper_v(std::move(s))...)
+      {}
     };
 
   template <StageT ...StageTs>
@@ -86,26 +244,86 @@ namespace mr {
   template <typename ...StageTs>
     Parallel(StageTs ...stages) -> Parallel<StageTs...>;
 
+  namespace detail {
+    template <typename T>
+      using to_shared_wrapper_t = FunctionWrapper<output_t<T>(const input_t<T> &)>;
+    template <typename T> to_shared_wrapper_t<T> to_shared_wrapper_v(T &&stage);
+  }
+
+  // Parallel whose branches all read one input held by the task instead of an element of a tuple each,
+  // so a large input is neither copied per branch nor has to be spread into a tuple by the previous stage.
+  // Branches take it by const reference (or by value, which copies it for that branch only)
+  template <StageT ...StageTs> requires (sizeof...(StageTs) > 0)
+    struct Broadcast<StageTs...> {
+      // for external use
+      using InputT = at_t<0, input_t<StageTs>...>;
+      using OutputT = mr::to_tuple_t<output_t<StageTs>...>;
+
+      static_assert((std::is_same_v<input_t<StageTs>, InputT> && ...),
+        "Branches of mr::Broadcast must take the same input");
+
+      using TupleT = mr::detail::flat_tuple<mr::detail::to_shared_wrapper_t<StageTs>...>;
+      using TaskT = Task<OutputT>;
+      using TaskImplT = detail::ParTaskImpl<sizeof...(StageTs), detail::Shared<InputT>, OutputT>;
+
+      static constexpr size_t size = sizeof...(StageTs);
+      static constexpr std::array<bool, size> io {is_io<StageTs>...};
+
+      std::chrono::nanoseconds cost;
+      std::unique_ptr<detail::CostModel<size>> cost_model;
+      std::array<Resource, size> resources;
+      TupleT stages;
+      constexpr Broadcast(StageTs... s)
+        : cost(std::max({detail::estimate(s)...}))
+        , cost_model(std::make_unique<detail::CostModel<size>>(std::array{detail::estimate(s)...}))
+        , resources {detail::resource_of(s)...}
+        , stages(detail::to_shared_wrapper_v(std::move(s))...)
+      {}
+    };
+
+  template <StageT ...StageTs>
+    struct CallableTraits<Broadcast<StageTs...>> {
+      using InputT = Broadcast<StageTs...>::InputT;
+      using OutputT = Broadcast<StageTs...>::OutputT;
+    };
+
+  template <typename ...StageTs>
+    Broadcast(StageTs ...stages) -> Broadcast<StageTs...>;
+
   template <StageT ...StageTs> requires (sizeof...(StageTs) > 0)
     struct Sequence<StageTs...> {
+    public:
+      // for external use
+      using InputT = at_t<0, input_t<StageTs>...>;
+      using OutputT = at_t<sizeof...(StageTs)-1, output_t<StageTs>...>;
+
     private:
       // for internal use
+      // output of every stage is the input of the next one, i.e. both lists shifted by one stage are equal
       static_assert(
-          mr::erase_v(0, mp::vector{mp::meta<input_t<StageTs>>...}) ==
-          mr::erase_v(sizeof...(StageTs) - 1, mp::vector{mp::meta<output_t<StageTs>>...})
+          std::is_same_v<
+            detail::type_list<InputT, output_t<StageTs>...>,
+            detail::type_list<input_t<StageTs>..., OutputT>>
         , "Invalid transform chain (type mismatch)");
 
     public:
-      // for external use
-      using InputT = at_t<0, input_t<StageTs>...>;
-      using OutputT = at_t<sizeof...(StageTs)-1, output_t<StageTs>...>;
-      using VariantT = mr::to_variant_t<input_t<StageTs>..., output_t<StageTs>...>;
-      using TupleT = mr::to_tuple_t<mr::detail::to_wrapper_t<StageTs>...>;
+      // NOTE: the chain is valid, so inputs of all stages but the first one are listed as outputs
+      using VariantT = mr::to_variant_t<InputT, output_t<StageTs>...>;
+      using TupleT = mr::detail::flat_tuple<mr::detail::to_wrapper_t<StageTs>...>;
       using TaskT = Task<OutputT>;
       using TaskImplT = detail::SeqTaskImpl<sizeof...(StageTs), VariantT, InputT, OutputT>;
 
+      static constexpr size_t size = sizeof...(StageTs);
+      static constexpr std::array<bool, size> io {is_io<StageTs>...};
+
+      std::chrono::nanoseconds cost;
+      std::array<Resource, size> resources;
       TupleT stages;
-      constexpr Sequence(StageTs... s) : stages(detail::to_wrapper_v(std::move(s))...) {}
+      constexpr Sequence(StageTs... s)
+        : cost((detail::estimate(s) + ...))
+        , resources {detail::resource_of(s)...}
+        , stages(detail::to_wrapper_v(std::move(s))...)
+      {}
     };
 
   template <StageT ...StageTs>
@@ -128,22 +346,76 @@ namespace mr {
 }
 
 namespace mr::detail {
+  // Nested prototype of a stage of an incremental task, applied once and rerun by every run of the stage
+  template <ApplicableT S>
+    struct NestedTask : NestedBase {
+      using InputT = typename S::InputT;
+      using OutputT = typename S::OutputT;
+
+      std::optional<InputT> input;
+      typename S::TaskT task;
+
+      explicit NestedTask(const S &stage)
+        : task(mr::apply(stage, FunctionWrapper<InputT(void)>([this]() -> InputT { return std::move(*input); })))
+      {
+        task->_incremental = true;
+      }
+
+      OutputT operator()(InputT &&value) {
+        input.emplace(std::move(value));
+        task->execute();
+        // NOTE: the nested task keeps its outputs, they are the cache of its next run
+        if constexpr (std::copy_constructible<OutputT>) {
+          return task->result_ref();
+        } else {
+          return task->result();
+        }
+      }
+    };
+
+  // nested prototype is applied per run, unless the stage belongs to an incremental task
+  template <ApplicableT S>
+    typename S::OutputT run_nested(const S &stage, typename S::InputT &&input) {
+      if (auto *slot = std::exchange(nested_slot, nullptr)) {
+        if (*slot == nullptr) {
+          *slot = std::make_unique<NestedTask<S>>(stage);
+        }
+        return static_cast<NestedTask<S> &>(**slot)(std::move(input));
+      }
+
+      // NOTE: the task runs once, so its input is moved in rather than copied from the initial value
+      auto task = mr::apply(stage, FunctionWrapper<typename S::InputT(void)>(
+        [&input]() -> typename S::InputT { return std::move(input); }
+      ));
+      task->execute();
+      return task->result();
+    }
+
   template <typename T>
     to_wrapper_t<T> to_wrapper_v(T&& stage) {
-      if constexpr (Callable<T>) {
+      if constexpr (DecoratorT<T>) {
+        return to_wrapper_v(std::forward<T>(stage).stage);
+      }
+      else if constexpr (UnpackedT<T>) {
+        // Feed parameters from the elements of the input tuple in place
+        return FunctionWrapper<output_t<T>(input_t<T> &&)>(
+          [inner_stage=std::forward<T>(stage)](input_t<T> &&input) mutable -> output_t<T> {
+            return std::apply(inner_stage, std::move(input));
+          }
+        );
+      }
+      else if constexpr (Callable<T>) {
         // Wrap raw callables directly
-        return FunctionWrapper<output_t<T>(input_t<T>)>(std::forward<T>(stage));
+        return FunctionWrapper<output_t<T>(input_t<T> &&)>(std::forward<T>(stage));
       }
       else if constexpr (ApplicableT<T>) {
         // Recursively convert nested Parallel/Sequence and wrap as function
         using InputT = typename T::InputT;
         using OutputT = typename T::OutputT;
 
-        return FunctionWrapper<OutputT(InputT)>(
-          [inner_stage=std::forward<T>(stage)](InputT input) mutable {
-            auto task = mr::apply(inner_stage, std::move(input));
-            task->execute();
-            return task->result();
+        return FunctionWrapper<OutputT(InputT &&)>(
+          [inner_stage=std::forward<T>(stage)](InputT &&input) mutable {
+            return run_nested(inner_stage, std::move(input));
           }
         );
       } else if constexpr (ApplicableRefT<T>) {
@@ -152,11 +424,49 @@ namespace mr::detail {
         using InputT = input_t<RealStageT>;
         using OutputT = output_t<RealStageT>;
 
-        return FunctionWrapper<OutputT(InputT)>(
-          [stage_ref = stage](InputT input) mutable {
-            auto task = mr::apply(stage_ref.get(), std::move(input));
-            task->execute();
-            return task->result();
+        return FunctionWrapper<OutputT(InputT &&)>(
+          [stage_ref = stage](InputT &&input) mutable {
+            return run_nested(stage_ref.get(), std::move(input));
+          }
+        );
+      }
+      else {
+        static_assert(false, "Unsupported stage type");
+      }
+    }
+
+  template <typename T>
+    to_shared_wrapper_t<T> to_shared_wrapper_v(T &&stage) {
+      using InputT = input_t<T>;
+      using OutputT = output_t<T>;
+
+      if constexpr (DecoratorT<T>) {
+        return to_shared_wrapper_v(std::forward<T>(stage).stage);
+      }
+      else if constexpr (UnpackedT<T>) {
+        return to_shared_wrapper_t<T>(
+          [inner_stage=std::forward<T>(stage)](const InputT &input) mutable -> OutputT {
+            return std::apply(inner_stage, input);
+          }
+        );
+      }
+      else if constexpr (Callable<T>) {
+        static_assert(std::is_invocable_v<T &, const InputT &>,
+          "Branch of mr::Broadcast must take its input by value or by const reference");
+        return to_shared_wrapper_t<T>(std::forward<T>(stage));
+      }
+      else if constexpr (ApplicableT<T>) {
+        // nested prototype owns its input, so it gets a copy
+        return to_shared_wrapper_t<T>(
+          [inner_stage=std::forward<T>(stage)](const InputT &input) mutable -> OutputT {
+            return run_nested(inner_stage, InputT(input));
+          }
+        );
+      }
+      else if constexpr (ApplicableRefT<T>) {
+        return to_shared_wrapper_t<T>(
+          [stage_ref = stage](const InputT &input) mutable -> OutputT {
+            return run_nested(stage_ref.get(), InputT(input));
           }
         );
       }
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+
+#include "mr-contractor/def.hpp"
+#include "mr-contractor/executor.hpp"
+#include "queue.hpp"
+#include "stages.hpp"
+#include "traits.hpp"
+
+namespace mr {
+  enum class FilterMode {
+    serial,   // one item at a time, in arrival order
+    parallel, // several items at once, order is not preserved
+  };
+
+  // what `Stream::push` does when the first queue is full
+  enum class Overflow {
+    block,
+    shed,
+  };
+
+  struct StreamConfig {
+    size_t capacity = 64;               // bound of every inter-stage queue
+    Overflow overflow = Overflow::block;
+    size_t parallelism = 0;             // contracts per parallel filter, 0 means executor's thread count
+  };
+
+  // Streaming mode of a `Sequence`: every stage becomes a filter connected to
+  // the next one by a bounded lock-free queue, so consecutive inputs occupy different stages at once.
+  // A filter which cannot hand its result downstream keeps it and stops consuming,
+  // which propagates backpressure up to `push`.
+  // NOTE: prototype has to outlive the stream,
+  //       stream has to be drained (`pop` returned std::nullopt after `close`) before it is destroyed
+  template <SequenceT S>
+    struct Stream {
+      static constexpr size_t size = S::size;
+
+      using InputT = typename S::InputT;
+      using OutputT = typename S::OutputT;
+      using ModesT = std::array<FilterMode, size>;
+
+      Stream(const S &seq, ModesT modes, StreamConfig config)
+        : Stream(seq, modes, config, std::make_index_sequence<size>())
+      {}
+
+      Stream(const Stream &) = delete;
+      Stream & operator=(const Stream &) = delete;
+
+      // returns false if the input was shed or the stream is closed
+      bool push(InputT input) {
+        if (_closed.load(std::memory_order_acquire)) {
+          return false;
+        }
+
+        auto &queue = std::get<0>(_queues);
+        _in_flight.fetch_add(1, std::memory_order_relaxed);
+        while (true) {
+          auto consumed = _consumed.load(std::memory_order_acquire);
+          if (queue.try_push(std::move(input))) {
+            break;
+          }
+          if (_overflow == Overflow::shed) {
+            _in_flight.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+          }
+          _consumed.wait(consumed, std::memory_order_acquire);
+        }
+
+        pushed<0>();
+        return true;
+      }
+
+      // blocks until a result is available, returns std::nullopt once the stream is closed and drained
+      std::optional<OutputT> pop() {
+        while (true) {
+          auto produced = _produced.load(std::memory_order_acquire);
+          if (auto result = try_pop(); result.has_value()) {
+            return result;
+          }
+          if (_closed.load(std::memory_order_acquire) && _in_flight.load(std::memory_order_acquire) == 0) {
+            return std::nullopt;
+          }
+          _produced.wait(produced, std::memory_order_acquire);
+        }
+      }
+
+      std::optional<OutputT> try_pop() {
+        auto result = std::get<size>(_queues).try_pop();
+        if (result.has_value()) {
+          _in_flight.fetch_sub(1, std::memory_order_acq_rel);
+          popped<size>();
+        }
+        return result;
+      }
+
+      // no more inputs will be accepted, already pushed ones are still delivered
+      void close() {
+        _closed.store(true, std::memory_order_release);
+        _produced.fetch_add(1, std::memory_order_release);
+        _produced.notify_all();
+      }
+
+    private:
+      template <typename WrapperT>
+        struct Filter {
+          using InputT = input_t<WrapperT>;
+          using OutputT = output_t<WrapperT>;
+
+          struct Worker {
+            Contract contract;
+            std::optional<OutputT> pending;   // result which did not fit into the next queue yet
+            std::atomic<bool> blocked = false;
+          };
+
+          detail::to_wrapper_view_t<WrapperT> stage;
+          std::unique_ptr<Worker[]> workers;
+          size_t size = 0;
+          std::atomic<size_t> next = 0;
+        };
+
+      template <typename TupleT> struct filters;
+      template <typename ...WrapperTs>
+        struct filters<detail::flat_tuple<WrapperTs...>> {
+          using type = std::tuple<Filter<WrapperTs>...>;
+          using queues = std::tuple<detail::BoundedQueue<input_t<WrapperTs>>..., detail::BoundedQueue<OutputT>>;
+        };
+
+      using FiltersT = typename filters<typename S::TupleT>::type;
+      using QueuesT = typename filters<typename S::TupleT>::queues;
+
+      template <size_t ...Is>
+        Stream(const S &seq, ModesT modes, StreamConfig config, std::index_sequence<Is...>)
+          : _queues(((void)Is, config.capacity)..., config.capacity)
+          , _overflow(config.overflow)
+        {
+          size_t parallelism = config.parallelism != 0 ? config.parallelism : Executor::get().thread_count();
+          (init<Is>(seq, modes[Is] == FilterMode::serial ? 1 : std::max<size_t>(parallelism, 1)), ...);
+        }
+
+      template <size_t I>
+        void init(const S &seq, size_t workers) {
+          auto &filter = std::get<I>(_filters);
+          filter.stage = detail::to_wrapper_view_v(detail::get<I>(seq.stages));
+          filter.workers = std::make_unique<typename std::tuple_element_t<I, FiltersT>::Worker[]>(workers);
+          filter.size = workers;
+          for (size_t w = 0; w < workers; w++) {
+            filter.workers[w].contract = Executor::get().create_contract(
+              [this, w]() { run<I>(w); }
+            );
+            if constexpr (S::io[I]) {
+              filter.workers[w].contract.route_to_io();
+            }
+            if (seq.resources[I]) {
+              filter.workers[w].contract.limit(*seq.resources[I].limiter());
+            }
+          }
+        }
+
+      template <size_t I>
+        void run(size_t w) {
+          auto &filter = std::get<I>(_filters);
+          auto &worker = filter.workers[w];
+          auto &input = std::get<I>(_queues);
+
+          if (worker.pending.has_value() && not flush<I>(worker)) {
+            return; // still blocked, will be woken up by the next stage
+          }
+
+          auto item = input.try_pop();
+          if (not item.has_value()) {
+            return;
+          }
+          popped<I>();
+
+          worker.pending.emplace(filter.stage(std::move(*item)));
+          if (not flush<I>(worker)) {
+            return;
+          }
+
+          if (not input.empty()) {
+            worker.contract.schedule();
+          }
+        }
+
+      template <size_t I, typename WorkerT>
+        bool flush(WorkerT &worker) {
+          auto &output = std::get<I + 1>(_queues);
+          if (not output.try_push(std::move(*worker.pending))) {
+            worker.blocked.store(true, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            // NOTE: retry to not miss the wake up from a consumer which popped in between
+            if (not output.try_push(std::move(*worker.pending))) {
+              return false;
+            }
+            worker.blocked.store(false, std::memory_order_relaxed);
+          }
+          worker.pending.reset();
+          pushed<I + 1>();
+          return true;
+        }
+
+      // a new item was pushed into queue I
+      template <size_t I>
+        void pushed() {
+          if constexpr (I < size) {
+            auto &filter = std::get<I>(_filters);
+            auto w = filter.next.fetch_add(1, std::memory_order_relaxed) % filter.size;
+            filter.workers[w].contract.schedule();
+          } else {
+            _produced.fetch_add(1, std::memory_order_release);
+            _produced.notify_all();
+          }
+        }
+
+      // an item was popped from queue I, so whoever is blocked on it may continue
+      template <size_t I>
+        void popped() {
+          std::atomic_thread_fence(std::memory_order_seq_cst);
+          if constexpr (I == 0) {
+            _consumed.fetch_add(1, std::memory_order_release);
+            _consumed.notify_all();
+          } else {
+            auto &filter = std::get<I - 1>(_filters);
+            for (size_t w = 0; w < filter.size; w++) {
+              if (filter.workers[w].blocked.exchange(false, std::memory_order_seq_cst)) {
+                filter.workers[w].contract.schedule();
+              }
+            }
+          }
+        }
+
+      QueuesT _queues;
+      FiltersT _filters;
+      Overflow _overflow;
+
+      std::atomic<bool> _closed = false;
+      std::atomic<size_t> _in_flight = 0;
+      std::atomic<size_t> _produced = 0;
+      std::atomic<size_t> _consumed = 0;
+    };
+
+  template <SequenceT S>
+    Stream<S> stream(const S &seq, typename Stream<S>::ModesT modes, StreamConfig config = {}) {
+      return Stream<S>(seq, modes, config);
+    }
+
+  template <SequenceT S>
+    Stream<S> stream(const S &seq, StreamConfig config = {}) {
+      typename Stream<S>::ModesT modes;
+      modes.fill(FilterMode::serial);
+      return Stream<S>(seq, modes, config);
+    }
+}
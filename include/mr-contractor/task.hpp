@@ -1,24 +1,185 @@
 #pragma once
 
+#include <array>
 #include <atomic>
-#include <barrier>
 #include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
 
 #include "mr-contractor/def.hpp"
+#include "mr-contractor/executor.hpp"
+#include "cost.hpp"
+#include "incremental.hpp"
+#include "task_group.hpp"
+
+namespace mr {
+  // Outputs of `Parallel` branches for which this is true are stored into padded slots first
+  // and gathered into the result tuple by the last branch, so neighbouring branches
+  // finishing on different threads do not write to the same cache line.
+  // Specialize it as false for types which are small but expensive to move.
+  template <typename T>
+    inline constexpr bool enable_output_padding = sizeof(T) < cache_line_size;
+}
 
 namespace mr::detail {
+  struct TaskState;
+
+  // Shared by a group of tasks which are waited on together (see `when_all`/`when_any`).
+  // Every task of the group arrives exactly once, so the waiter parks on a single counter.
+  struct CompletionListener {
+    static constexpr size_t none = std::numeric_limits<size_t>::max();
+
+    std::atomic<size_t> remaining;
+    std::atomic<size_t> first = none;
+
+    // completed once every task of the group arrived
+    TaskState *owner = nullptr;
+    // called once every task of the group arrived, if there is no `owner`
+    FunctionWrapper<void(void) noexcept> on_complete;
+
+    explicit CompletionListener(size_t count) noexcept : remaining(count) {}
+
+    void arrive(size_t index) noexcept;
+  };
+
+  // Completion state common for every task type.
+  // NOTE: the flag (polled by waiters) and the listener are written once per run, by the last contract.
+  //       They take a cache line of their own, apart from the state read by every contract
+  struct TaskState {
+    alignas(cache_line_size) std::atomic_flag completion_flag{};
+
+    TaskState() = default;
+    TaskState(const TaskState &) = delete;
+    TaskState & operator=(const TaskState &) = delete;
+
+    bool is_ready() const noexcept {
+      return completion_flag.test(std::memory_order_acquire);
+    }
+
+    // called before every run of the task
+    void reset_completion() noexcept {
+      completion_flag.clear(std::memory_order_relaxed);
+      _listener.store(0, std::memory_order_release);
+      _active_deadline = _deadline.none() ? Executor::current_deadline() : _deadline;
+      _missed.store(false, std::memory_order_relaxed);
+    }
+
+    // tasks without a deadline inherit the one of the contract which schedules them
+    void set_deadline(const Deadline &deadline) noexcept {
+      _deadline = deadline;
+    }
+
+    // deadline of the current run, its contracts are scheduled with it
+    const Deadline & deadline() const noexcept {
+      return _active_deadline;
+    }
+
+    // called by every contract before its stage, true if the stage has to be skipped
+    bool expired() noexcept {
+      if (_active_deadline.drop_missed && Deadline::Clock::now() > _active_deadline.at) {
+        _missed.store(true, std::memory_order_relaxed);
+        return true;
+      }
+      return false;
+    }
+
+    // true if stages of the last run were dropped after the deadline, the result must not be used then
+    bool missed() const noexcept {
+      return _missed.load(std::memory_order_relaxed);
+    }
+
+    // called by the contract which finishes the task
+    void complete() noexcept {
+      auto listener = _listener.exchange(completed_tag, std::memory_order_acq_rel);
+      auto index = _listener_index.load(std::memory_order_relaxed);
+
+      completion_flag.test_and_set(std::memory_order_release);
+      completion_flag.notify_all();
+
+      if (listener != 0 && listener != completed_tag) {
+        reinterpret_cast<CompletionListener *>(listener)->arrive(index);
+      }
+      Executor::get().notify_waiters();
+    }
+
+    // the waiting thread runs pending contracts until the task completes,
+    // so it adds capacity and waits inside contracts (nested tasks) cannot starve the pool
+    void await() const noexcept {
+      Executor::get().help_until([this] { return is_ready(); });
+    }
+
+    // `listener` is notified on completion (immediately if the task is already completed).
+    // NOTE: a task takes one listener per run, it can not be waited on by two `when_all`/`when_any`
+    //       (or be driven by `Periodic` and waited on) at once
+    void listen(CompletionListener &listener, size_t index) {
+      auto current = _listener.load(std::memory_order_acquire);
+      if (current == 0) {
+        // NOTE: published by the exchange below, `complete` reads it after taking the listener
+        _listener_index.store(index, std::memory_order_relaxed);
+        if (_listener.compare_exchange_strong(
+              current, reinterpret_cast<std::uintptr_t>(&listener), std::memory_order_acq_rel)) {
+          return;
+        }
+      }
+      if (current != completed_tag) {
+        throw std::logic_error("mr::TaskState::listen: the task already has a listener");
+      }
+      listener.arrive(index);
+    }
+
+    // returns false if the task has already taken `listener` and will arrive to it
+    bool unlisten(CompletionListener &listener) noexcept {
+      auto expected = reinterpret_cast<std::uintptr_t>(&listener);
+      return _listener.compare_exchange_strong(expected, 0, std::memory_order_acq_rel);
+    }
+
+  private:
+    static constexpr std::uintptr_t completed_tag = 1;
+
+    std::atomic<std::uintptr_t> _listener = 0;
+    std::atomic<size_t> _listener_index = 0;
+
+    alignas(cache_line_size) Deadline _deadline {};
+    Deadline _active_deadline {};
+    std::atomic<bool> _missed = false;
+  };
+
+  inline void CompletionListener::arrive(size_t index) noexcept {
+    auto expected = none;
+    first.compare_exchange_strong(expected, index, std::memory_order_acq_rel);
+    // NOTE: `when_any` polls the counters and may destroy the listener as soon as the last task arrived,
+    //       so nothing is read from it after the decrement unless there is a completion to deliver
+    auto *completed = owner;
+    bool callback = static_cast<bool>(on_complete);
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      if (completed != nullptr) {
+        completed->complete();
+      } else if (callback) {
+        on_complete();
+      }
+    }
+  }
+
   // TODO:
   //    - introduce `DeferredTask`, which takes `getter` instead of `initial`
   //        - make `NestedTaskT` concept which is Deferred<Par/Seq>Task
   template <typename ResultT>
-    struct TaskBase {
+    struct TaskBase : TaskState {
       TaskBase() = default;
       virtual ~TaskBase() = default;
 
       // customization points
       [[nodiscard]]
       virtual ResultT    result()        = 0;
+      // valid until the next `schedule()`
+      virtual ResultT &  result_ref()    = 0;
       virtual void       update_object() = 0;
       virtual TaskBase & schedule()      = 0;
       virtual TaskBase & wait()          = 0;
@@ -26,20 +187,28 @@ namespace mr::detail {
       TaskBase & execute() {
         return schedule().wait();
       }
+
+      // if set, the last stage constructs the result right there (see `apply_into`)
+      std::optional<ResultT> *_destination = nullptr;
+      // if set, unchanged `Parallel` branches reuse their previous outputs (see `apply_incremental`)
+      bool _incremental = false;
     };
 
   template <size_t NumOfTasks, typename VariantT, std::copyable InputT, typename ResultT>
     struct SeqTaskImpl : TaskBase<ResultT> {
       static constexpr auto size = NumOfTasks;
 
-      InputT _initial;
+      // NOTE: empty if the task takes a getter, so `InputT` does not have to be default constructible
+      std::optional<InputT> _initial;
 
-      FunctionWrapper<InputT(void)> _getter = [this]() -> InputT { return _initial; };
+      FunctionWrapper<InputT(void)> _getter = [this]() -> InputT { return *_initial; };
       std::unique_ptr<VariantT> _object;
 
       std::array<Contract, NumOfTasks> contracts {};
-
-      std::atomic_flag completion_flag{};
+      // nested prototypes of the stages, kept between runs of an incremental task
+      std::array<NestedSlot, NumOfTasks> _nested {};
+      // groups the stages spawned into (see `TaskGroup::current`)
+      std::array<std::unique_ptr<TaskGroup>, NumOfTasks> _groups {};
 
       SeqTaskImpl() = default;
       ~SeqTaskImpl() override = default;
@@ -59,8 +228,10 @@ namespace mr::detail {
         : _initial(std::move(other._initial))
         , _getter(std::move(other._getter))
         , _object(std::move(other._object))
-        , contracts(std::move(other.contracts))
-        , completion_flag(other.completion_flag.test()) {
+        , contracts(std::move(other.contracts)) {
+          if (other.completion_flag.test()) {
+            this->completion_flag.test_and_set();
+          }
           other.completion_flag.clear();
       }
       SeqTaskImpl& operator=(SeqTaskImpl&& other) noexcept {
@@ -70,10 +241,10 @@ namespace mr::detail {
           _object = std::move(other._object);
           contracts = std::move(other.contracts);
           if (other.completion_flag.test()) {
-            completion_flag.test_and_set();
+            this->completion_flag.test_and_set();
           }
           else {
-            completion_flag.clear();
+            this->completion_flag.clear();
           }
           other.completion_flag.clear();
         }
@@ -81,26 +252,34 @@ namespace mr::detail {
       }
 
       void update_object() override final {
-        this->completion_flag.clear();
-        _object = std::make_unique<VariantT>(_getter());
+        this->reset_completion();
+        if (_object) {
+          _object->template emplace<InputT>(elide<InputT>(_getter));
+        } else {
+          _object = std::make_unique<VariantT>(std::in_place_type<InputT>, elide<InputT>(_getter));
+        }
       }
 
       TaskBase<ResultT> & schedule() override final {
         update_object();
-        this->contracts.front().schedule();
+        this->contracts.front().schedule(this->deadline());
         return *this;
       }
 
       TaskBase<ResultT> & wait() override final {
-        this->completion_flag.wait(false);
+        this->await();
         return *this;
       }
 
       [[nodiscard]] ResultT result() override final {
-        auto &v = *_object.get();
-        auto &r = std::get<ResultT>(v);
+        return std::move(result_ref());
+      }
 
-        return std::move(r);
+      ResultT & result_ref() override final {
+        if (this->_destination != nullptr) {
+          return **this->_destination;
+        }
+        return std::get<ResultT>(*_object.get());
       }
     };
 
@@ -108,6 +287,86 @@ namespace mr::detail {
   template <size_t N, typename ...Ts> constexpr bool is_seq_task_impl<SeqTaskImpl<N, Ts...>> = true;
   template <typename T> concept SeqTaskImplInstance = is_seq_task_impl<T>;
 
+  // Input of a `Broadcast`, a single value read by every branch
+  // NOTE: empty until the first run, so `T` does not have to be default constructible
+  template <typename T>
+    struct Shared {
+      std::optional<T> value;
+
+      Shared() = default;
+      Shared(T value)
+        : value(std::move(value))
+      {}
+    };
+
+  // caches of the branches of a `Broadcast`: they all read one input, so it is remembered
+  // (and compared) once per run instead of once per branch
+  template <typename T, size_t N>
+    struct SharedBranchCaches {
+      using KeyT = typename change_key<T>::type;
+
+      // called once per run, before the branches start
+      void observe(const Shared<T> &input) {
+        if constexpr (change_key<T>::comparable) {
+          if (_key.has_value() && *_key == change_key<T>::of(*input.value)) {
+            return;
+          }
+          _key.emplace(change_key<T>::of(*input.value));
+        }
+        invalidate();
+      }
+
+      // NOTE: every branch only touches its own flag, so they do not race
+      template <size_t I>
+        bool hit(const Shared<T> &) const noexcept {
+          return _valid[I];
+        }
+
+      template <size_t I>
+        void commit() noexcept {
+          _valid[I] = true;
+        }
+
+      void invalidate() noexcept {
+        _valid.fill(false);
+      }
+
+    private:
+      std::optional<KeyT> _key;
+      std::array<bool, N> _valid {};
+    };
+
+  template <typename T, size_t N>
+    struct branch_caches<Shared<T>, N> {
+      using type = SharedBranchCaches<T, N>;
+    };
+
+  // input of branch `I` of a parallel task
+  template <size_t I, typename ...Ts>
+    auto & branch_input(std::tuple<Ts...> &input) noexcept {
+      return std::get<I>(input);
+    }
+
+  template <size_t I, typename T>
+    T & branch_input(Shared<T> &input) noexcept {
+      return *input.value;
+    }
+
+  // NOTE: outputs are moved out of their slots by `gather`, which must not throw
+  template <typename T>
+    constexpr bool pad_output = enable_output_padding<T> && std::is_nothrow_move_assignable_v<T>;
+
+  template <typename T>
+    using output_slot_t = std::conditional_t<pad_output<T>, Padded<std::optional<T>>, std::monostate>;
+
+  template <typename ResultT> struct output_slots;
+  template <typename ...Ts>
+    struct output_slots<std::tuple<Ts...>> {
+      using type = std::tuple<output_slot_t<Ts>...>;
+      static constexpr bool any = (pad_output<Ts> || ...);
+    };
+  template <typename ResultT> using output_slots_t = typename output_slots<ResultT>::type;
+
   template <size_t NumOfTasks, typename InputT, typename ResultT>
     struct ParTaskImpl : TaskBase<ResultT> {
       static constexpr auto size = NumOfTasks;
@@ -118,21 +377,33 @@ namespace mr::detail {
       FunctionWrapper<void(void) noexcept> _on_finish = []() noexcept {};
 
       std::array<Contract, NumOfTasks> contracts {};
+      std::array<NestedSlot, NumOfTasks> _nested {};
+      std::array<std::unique_ptr<TaskGroup>, NumOfTasks> _groups {};
 
       InputT _input;
       std::unique_ptr<ResultT> _object = std::make_unique<ResultT>();
-      std::barrier<FunctionView<void() noexcept>> _barrier {
-        NumOfTasks + 1, // NOTE: +1 to account for the calling thread waiting on this
-        FunctionView<void(void) noexcept>(_on_finish)
-      };
+      // NOTE: a single branch shares its cache lines with nobody, nor do outputs of which none is padded
+      std::unique_ptr<output_slots_t<ResultT>> _slots =
+        NumOfTasks > 1 && output_slots<ResultT>::any ? std::make_unique<output_slots_t<ResultT>>() : nullptr;
+
+      // branches which have not finished yet, the last one completes the task.
+      // NOTE: written by every branch, kept apart from the state they read
+      alignas(cache_line_size) std::atomic<size_t> _remaining {NumOfTasks};
+
+      // owned by the prototype, null if branch order does not matter
+      alignas(cache_line_size) CostModel<NumOfTasks> *_cost_model = nullptr;
+      // branches record their times into the model during this run
+      bool _measure_costs = false;
+      size_t _runs = 0;
+
+      // created by the first incremental run
+      std::unique_ptr<branch_caches_t<InputT, NumOfTasks>> _caches;
 
       ParTaskImpl() = default;
       ~ParTaskImpl() override = default;
 
       ParTaskImpl(const ParTaskImpl &) = delete;
       ParTaskImpl & operator=(const ParTaskImpl &) = delete;
-      ParTaskImpl(ParTaskImpl &&) = default;
-      ParTaskImpl & operator=(ParTaskImpl &&) = default;
 
       ParTaskImpl(InputT initial)
         : _initial(std::move(initial))
@@ -143,25 +414,101 @@ namespace mr::detail {
       {}
 
       void update_object() override final {
+        this->reset_completion();
+        _remaining.store(NumOfTasks, std::memory_order_relaxed);
+        if (this->_incremental && _caches == nullptr) {
+          _caches = std::make_unique<branch_caches_t<InputT, NumOfTasks>>();
+        }
+        // NOTE: outputs cached by an incremental run stay in the destination
+        if (this->_destination != nullptr && (_caches == nullptr || not this->_destination->has_value())) {
+          invalidate();
+          this->_destination->emplace();
+        }
         _input = _getter();
+        if (_caches != nullptr) {
+          _caches->observe(_input);
+        }
+      }
+
+      // moves outputs of the branches which ran from their slots into the result
+      // NOTE: skipped branches (expired or reused by an incremental run) left their slots empty
+      void gather() noexcept {
+        if (_slots == nullptr) {
+          return;
+        }
+        [this]<size_t ...Is>(std::index_sequence<Is...>) {
+          auto move_out = [this]<size_t I>(std::integral_constant<size_t, I>) {
+            if constexpr (pad_output<std::tuple_element_t<I, ResultT>>) {
+              auto &slot = std::get<I>(*_slots).value;
+              if (slot.has_value()) {
+                std::get<I>(result_ref()) = std::move(*slot);
+                slot.reset();
+              }
+            }
+          };
+          (move_out(std::integral_constant<size_t, Is>{}), ...);
+        }(std::make_index_sequence<NumOfTasks>());
+      }
+
+      // cached outputs of all branches are no longer valid
+      void invalidate() noexcept {
+        if (_caches != nullptr) {
+          _caches->invalidate();
+        }
       }
 
       TaskBase<ResultT> & wait() override final {
-        _barrier.arrive_and_wait();
+        this->await();
         return *this;
       }
 
+      // called by a branch with its output
+      template <size_t I, typename T>
+        void store(T &&output) {
+          if constexpr (pad_output<std::tuple_element_t<I, ResultT>>) {
+            if (_slots != nullptr) {
+              std::get<I>(*_slots).value.emplace(std::forward<T>(output));
+              return;
+            }
+          }
+          std::get<I>(result_ref()) = std::forward<T>(output);
+        }
+
+      // called by every branch once its result is stored
+      void arrive() noexcept {
+        if (_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          gather();
+          _on_finish();
+          this->complete();
+        }
+      }
+
       TaskBase<ResultT> & schedule() override final {
         update_object();
-        for (auto &c : contracts) {
-          c.schedule();
+        if (_cost_model != nullptr) {
+          _measure_costs = _runs++ % CostModel<NumOfTasks>::sample_interval == 0;
+          for (auto i : _cost_model->order()) {
+            contracts[i].schedule(this->deadline());
+          }
+        } else {
+          for (auto &c : contracts) {
+            c.schedule(this->deadline());
+          }
         }
         return *this;
       }
 
       [[nodiscard]] ResultT result() override final {
-        ResultT &r = *_object.get();
-        return std::move(r);
+        invalidate();
+        return std::move(result_ref());
+      }
+
+      // branches store their results right here
+      ResultT & result_ref() override final {
+        if (this->_destination != nullptr) {
+          return **this->_destination;
+        }
+        return *_object.get();
       }
     };
 
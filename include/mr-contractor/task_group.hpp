@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+#include "def.hpp"
+#include "executor.hpp"
+
+namespace mr {
+  struct TaskGroup;
+}
+
+namespace mr::detail {
+  template <typename F>
+    void then(std::unique_ptr<TaskGroup> &group, F &&next);
+}
+
+namespace mr {
+  // Work forked onto the executor and joined as a whole.
+  // Inside a stage `TaskGroup::current()` is the group of that stage: the stage returns without waiting,
+  // the next stage (or the completion of the task) is left to the last child to finish, so no worker is held.
+  // Children may spawn further children into the same group, they get it if they take a `TaskGroup &`.
+  // Elsewhere a group is joined by `wait()`, which runs pending contracts meanwhile.
+  // NOTE: the output of the stage is stored into the task before the children finish,
+  //       they may write into storage it owns (e.g. elements of a returned vector) but not into the output object itself
+  struct TaskGroup {
+    TaskGroup() = default;
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup & operator=(const TaskGroup &) = delete;
+
+    ~TaskGroup() {
+      wait();
+    }
+
+    // group of the stage which the calling thread runs
+    static TaskGroup & current() {
+      auto *slot = detail::group_slot;
+      if (slot == nullptr) {
+        throw std::logic_error("mr::TaskGroup::current: called outside of a stage");
+      }
+      if (slot == &detail::no_group_slot) {
+        throw std::logic_error("mr::TaskGroup::current: not supported in dynamic prototypes");
+      }
+      if (*slot == nullptr) {
+        *slot = std::make_unique<TaskGroup>();
+        (*slot)->_stage = true;
+      }
+      (*slot)->arm();
+      return **slot;
+    }
+
+    // `f` runs on the executor, with the deadline of the calling contract.
+    // Children are queued in the group and run by its runners, a contract per worker created by the first spawn,
+    // so a child costs no contract of its own
+    template <typename F>
+      void spawn(F &&f) {
+        _pending.fetch_add(1, std::memory_order_relaxed);
+
+        Contract *runner;
+        {
+          std::lock_guard lock(_jobs_mutex);
+          if (_runners == nullptr) {
+            make_runners();
+          }
+          _jobs.emplace_back([f = std::forward<F>(f)](TaskGroup &group) mutable {
+            if constexpr (std::invocable<decltype(f) &, TaskGroup &>) {
+              f(group);
+            } else {
+              f();
+            }
+          });
+          runner = &_runners[_next_runner++ % _runner_count];
+        }
+        runner->schedule(Executor::current_deadline());
+      }
+
+    // children spawned so far (and their children) finished
+    bool done() const noexcept {
+      return _pending.load(std::memory_order_acquire) == (_armed.load(std::memory_order_acquire) ? 1 : 0);
+    }
+
+    // runs pending contracts until `done()`.
+    // NOTE: not needed for the group of a stage, which is joined by the task itself
+    void wait() const noexcept {
+      if (not done()) {
+        Executor::get().help_until([this] { return done(); });
+      }
+    }
+
+  private:
+    template <typename F>
+      friend void detail::then(std::unique_ptr<TaskGroup> &group, F &&next);
+
+    // the stage holds a reference of its own until it returns
+    void arm() noexcept {
+      if (not _armed.load(std::memory_order_relaxed)) {
+        _pending.store(1, std::memory_order_relaxed);
+        _armed.store(true, std::memory_order_release);
+      }
+    }
+
+    // NOTE: `_jobs_mutex` has to be locked
+    void make_runners() {
+      _runner_count = std::max<size_t>(Executor::get().thread_count(), 1);
+      _runners = std::make_unique<Contract[]>(_runner_count);
+      for (size_t i = 0; i < _runner_count; i++) {
+        _runners[i] = Executor::get().create_contract([this] { run_jobs(); });
+      }
+    }
+
+    // runs queued children until none is left, a runner scheduled meanwhile runs again
+    void run_jobs() {
+      auto job = pop_job();
+      while (job) {
+        job(*this);
+        // NOTE: the group may be destroyed by the last `finish`, the next child is taken out before
+        auto next = pop_job();
+        finish();
+        job = std::move(next);
+      }
+    }
+
+    FunctionWrapper<void(TaskGroup &)> pop_job() {
+      std::lock_guard lock(_jobs_mutex);
+      if (_jobs.empty()) {
+        return nullptr;
+      }
+      auto job = std::move(_jobs.front());
+      _jobs.pop_front();
+      return job;
+    }
+
+    void finish() noexcept {
+      // NOTE: a plain group may be destroyed by its waiter right after the decrement, a stage group is kept by its task
+      bool stage = _stage;
+      auto pending = _pending.fetch_sub(1, std::memory_order_acq_rel) - 1;
+      if (pending == 0 && stage) {
+        // the continuation may complete (and free) the task, so it is taken out first
+        std::exchange(_continuation, nullptr)();
+      }
+      // `done()` may hold from now on
+      if (pending <= 1) {
+        Executor::get().notify_waiters();
+      }
+    }
+
+    std::atomic<size_t> _pending = 0;
+    // set by the stage which uses the group for the current run, until the stage returns
+    std::atomic<bool> _armed = false;
+    bool _stage = false;
+    FunctionWrapper<void(void) noexcept> _continuation;
+
+    std::mutex _jobs_mutex;
+    std::deque<FunctionWrapper<void(TaskGroup &)>> _jobs;
+    std::unique_ptr<Contract[]> _runners;
+    size_t _runner_count = 0;
+    size_t _next_runner = 0;
+  };
+}
+
+namespace mr::detail {
+  // called by a contract after its stage: `next` runs once the children spawned by the stage finished,
+  // right away if the stage did not use its group
+  template <typename F>
+    void then(std::unique_ptr<TaskGroup> &group, F &&next) {
+      if (group == nullptr || not group->_armed.load(std::memory_order_relaxed)) {
+        next();
+        return;
+      }
+      group->_armed.store(false, std::memory_order_release);
+      // NOTE: only the stage and its children spawn into the group, so none can be added once they are done
+      if (group->_pending.load(std::memory_order_acquire) == 1) {
+        group->_pending.store(0, std::memory_order_relaxed);
+        next();
+        return;
+      }
+      group->_continuation = std::forward<F>(next);
+      group->finish();
+    }
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <tuple>
+#include <type_traits>
+
 #include <function2/function2.hpp>
 
 namespace mr {
@@ -10,8 +13,20 @@ namespace mr {
       struct InputTOutputT {
         using InputT = I;
         using OutputT = O;
+        static constexpr bool unpacked = false;
+      };
+
+    // Stage with several parameters is fed from the elements of a tuple,
+    // which are passed by reference so parameters of reference type never relocate them
+    template <typename O, typename ...As>
+      struct ArgsTraits : InputTOutputT<std::tuple<std::remove_cvref_t<As>...>, O> {
+        static constexpr bool unpacked = true;
       };
 
+    // Parameter taken by reference still makes the stage accept its value type
+    template <typename O, typename A>
+      struct ArgsTraits<O, A> : InputTOutputT<std::remove_cvref_t<A>, O> {};
+
   }
 
   // Primary template declaration
@@ -19,64 +34,64 @@ namespace mr {
     struct CallableTraits;
 
   // Specialization for plain function types
-  template<typename R, typename A>
-    struct CallableTraits<R(A)> : details::InputTOutputT<A, R> {};
+  template<typename R, typename ...As>
+    struct CallableTraits<R(As...)> : details::ArgsTraits<R, As...> {};
 
   // Specialization for function pointers
-  template<typename R, typename A>
-    struct CallableTraits<R(*)(A)> : details::InputTOutputT<A, R> {};
+  template<typename R, typename ...As>
+    struct CallableTraits<R(*)(As...)> : details::ArgsTraits<R, As...> {};
 
   // Specializations for fu2
-  template<typename R, typename A>
-    struct CallableTraits<fu2::function<R(A)>> : details::InputTOutputT<A, R> {};
+  template<typename R, typename ...As>
+    struct CallableTraits<fu2::function<R(As...)>> : details::ArgsTraits<R, As...> {};
 
-  template<typename R, typename A>
-    struct CallableTraits<fu2::function_view<R(A)>> : details::InputTOutputT<A, R> {};
+  template<typename R, typename ...As>
+    struct CallableTraits<fu2::function_view<R(As...)>> : details::ArgsTraits<R, As...> {};
 
-  template<typename R, typename A>
-    struct CallableTraits<fu2::unique_function<R(A)>> : details::InputTOutputT<A, R> {};
+  template<typename R, typename ...As>
+    struct CallableTraits<fu2::unique_function<R(As...)>> : details::ArgsTraits<R, As...> {};
 
   // Helper to decompose member function pointer types (operator() for functors/lambdas)
   template<typename T>
     struct CallableMemberTraits;
 
   // non-volatile specializations
-  template<typename R, typename C, typename A>
-    struct CallableMemberTraits<R (C::*)(A)> : details::InputTOutputT<A, R> {};
+  template<typename R, typename C, typename ...As>
+    struct CallableMemberTraits<R (C::*)(As...)> : details::ArgsTraits<R, As...> {};
 
-  template<typename R, typename C, typename A>
-    struct CallableMemberTraits<R (C::*)(A) const> : details::InputTOutputT<A, R> {};
+  template<typename R, typename C, typename ...As>
+    struct CallableMemberTraits<R (C::*)(As...) const> : details::ArgsTraits<R, As...> {};
 
-  template<typename R, typename C, typename A>
-    struct CallableMemberTraits<R (C::*)(A) &> : details::InputTOutputT<A, R> {};
+  template<typename R, typename C, typename ...As>
+    struct CallableMemberTraits<R (C::*)(As...) &> : details::ArgsTraits<R, As...> {};
 
-  template<typename R, typename C, typename A>
-    struct CallableMemberTraits<R (C::*)(A) const &> : details::InputTOutputT<A, R> {};
+  template<typename R, typename C, typename ...As>
+    struct CallableMemberTraits<R (C::*)(As...) const &> : details::ArgsTraits<R, As...> {};
 
-  template<typename R, typename C, typename A>
-    struct CallableMemberTraits<R (C::*)(A) &&> : details::InputTOutputT<A, R> {};
+  template<typename R, typename C, typename ...As>
+    struct CallableMemberTraits<R (C::*)(As...) &&> : details::ArgsTraits<R, As...> {};
 
-  template<typename R, typename C, typename A>
-    struct CallableMemberTraits<R (C::*)(A) const &&> : details::InputTOutputT<A, R> {};
+  template<typename R, typename C, typename ...As>
+    struct CallableMemberTraits<R (C::*)(As...) const &&> : details::ArgsTraits<R, As...> {};
 
   // volatile specializations
-  template<typename R, typename C, typename A>
-    struct CallableMemberTraits<R(C::*)(A) volatile> : details::InputTOutputT<A, R> {};
+  template<typename R, typename C, typename ...As>
+    struct CallableMemberTraits<R(C::*)(As...) volatile> : details::ArgsTraits<R, As...> {};
 
-  template<typename R, typename C, typename A>
-    struct CallableMemberTraits<R(C::*)(A) const volatile> : details::InputTOutputT<A, R> {};
+  template<typename R, typename C, typename ...As>
+    struct CallableMemberTraits<R(C::*)(As...) const volatile> : details::ArgsTraits<R, As...> {};
 
-  template<typename R, typename C, typename A>
-    struct CallableMemberTraits<R(C::*)(A) volatile &> : details::InputTOutputT<A, R> {};
+  template<typename R, typename C, typename ...As>
+    struct CallableMemberTraits<R(C::*)(As...) volatile &> : details::ArgsTraits<R, As...> {};
 
-  template<typename R, typename C, typename A>
-    struct CallableMemberTraits<R(C::*)(A) const volatile &> : details::InputTOutputT<A, R> {};
+  template<typename R, typename C, typename ...As>
+    struct CallableMemberTraits<R(C::*)(As...) const volatile &> : details::ArgsTraits<R, As...> {};
 
-  template<typename R, typename C, typename A>
-    struct CallableMemberTraits<R(C::*)(A) volatile &&> : details::InputTOutputT<A, R> {};
+  template<typename R, typename C, typename ...As>
+    struct CallableMemberTraits<R(C::*)(As...) volatile &&> : details::ArgsTraits<R, As...> {};
 
-  template<typename R, typename C, typename A>
-    struct CallableMemberTraits<R(C::*)(A) const volatile &&> : details::InputTOutputT<A, R> {};
+  template<typename R, typename C, typename ...As>
+    struct CallableMemberTraits<R(C::*)(As...) const volatile &&> : details::ArgsTraits<R, As...> {};
 
   // Primary template for functors, lambdas, and other callable objects
   template<typename FuncT>
@@ -89,18 +104,31 @@ namespace mr {
       public:
         using InputT = typename Impl::InputT;
         using OutputT = typename Impl::OutputT;
+        static constexpr bool unpacked = Impl::unpacked;
     };
 
   template <typename F> using input_t = CallableTraits<std::remove_cvref_t<F>>::InputT;
   template <typename F> using output_t = CallableTraits<std::remove_cvref_t<F>>::OutputT;
 
-  // Concept to check if T is a valid callable with one argument
+  // true if the stage takes the elements of its input tuple as separate arguments
+  template <typename F>
+    concept UnpackedT = CallableTraits<std::remove_cvref_t<F>>::unpacked;
+
+  namespace details {
+    template <typename F, typename I>
+      constexpr bool is_unpack_invocable = false;
+
+    template <typename F, typename ...Is>
+      constexpr bool is_unpack_invocable<F, std::tuple<Is...>> = std::is_invocable_r_v<output_t<F>, F, Is...>;
+  }
+
+  // Concept to check if T is a valid callable with one argument (or several, see `UnpackedT`)
   template<typename T>
     concept Callable = requires {
       // Ensure CallableTraits<T> provides InputT and OutputT
       typename input_t<T>;
       typename output_t<T>;
-      // Ensure T can be called with InputT and returns OutputT
-      requires std::is_invocable_r_v<output_t<T>, T, input_t<T>>;
+      // Ensure T can be called with InputT (or its elements) and returns OutputT
+      requires (UnpackedT<T> ? details::is_unpack_invocable<T, input_t<T>> : std::is_invocable_r_v<output_t<T>, T, input_t<T>>);
     };
 }
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <ranges>
+#include <tuple>
+
+#include "mr-contractor/def.hpp"
+#include "mr-contractor/executor.hpp"
+#include "task.hpp"
+
+namespace mr::detail {
+  template <typename T>
+    TaskState & as_task_state(T &task) {
+      if constexpr (std::derived_from<T, TaskState>) {
+        return task;
+      } else {
+        return *task;
+      }
+    }
+
+  // `listener` takes every task of `tasks` in order. If one of them already has a listener of its own,
+  // the tasks which took this one are released (or waited for, if they are completing) before the error is rethrown
+  template <std::ranges::forward_range R>
+    void listen_all(CompletionListener &listener, R &&tasks) {
+      size_t index = 0;
+      try {
+        for (auto &task : tasks) {
+          as_task_state(task).listen(listener, index);
+          index++;
+        }
+      } catch (...) {
+        auto count = static_cast<size_t>(std::ranges::distance(tasks));
+        size_t detached = 0;
+        for (auto &task : tasks | std::views::take(index)) {
+          detached += as_task_state(task).unlisten(listener);
+        }
+        Executor::get().help_until([&listener, left = count - index + detached] {
+          return listener.remaining.load(std::memory_order_acquire) == left;
+        });
+        throw;
+      }
+    }
+
+  // Combined task of `when_all`: completes when all of the referenced tasks complete
+  template <typename ...ResultTs>
+    struct WhenAllTask : TaskBase<std::tuple<ResultTs...>> {
+      using ResultT = std::tuple<ResultTs...>;
+
+      std::tuple<TaskBase<ResultTs> &...> _tasks;
+      CompletionListener _listener {sizeof...(ResultTs)};
+      bool _listening = false;
+      std::optional<ResultT> _result;
+
+      WhenAllTask(TaskBase<ResultTs> &...tasks)
+        : _tasks(tasks...)
+      {
+        _listener.owner = this;
+      }
+
+      void update_object() override final {
+        this->reset_completion();
+        _result.reset();
+        if (this->_destination != nullptr) {
+          this->_destination->reset();
+        }
+        _listener.remaining.store(sizeof...(ResultTs), std::memory_order_relaxed);
+        _listening = false;
+      }
+
+      TaskBase<ResultT> & schedule() override final {
+        update_object();
+        std::apply([](auto &...tasks) { (tasks.schedule(), ...); }, _tasks);
+        listen();
+        return *this;
+      }
+
+      // may also be used on tasks which were scheduled by somebody else
+      TaskBase<ResultT> & wait() override final {
+        if (not _listening) {
+          listen();
+        }
+        this->await();
+        return *this;
+      }
+
+      [[nodiscard]] ResultT result() override final {
+        return std::move(result_ref());
+      }
+
+      // results are moved out of the tasks once per run
+      ResultT & result_ref() override final {
+        auto &storage = this->_destination != nullptr ? *this->_destination : _result;
+        if (not storage.has_value()) {
+          std::apply([&storage](auto &...tasks) { storage.emplace(tasks.result()...); }, _tasks);
+        }
+        return *storage;
+      }
+
+    private:
+      void listen() {
+        _listening = true;
+        auto states = std::apply([](auto &...tasks) { return std::array<TaskState *, sizeof...(ResultTs)> {&tasks...}; }, _tasks);
+        listen_all(_listener, states);
+      }
+    };
+}
+
+namespace mr {
+  // Combined task which schedules all `tasks` and completes once every one of them does.
+  // The caller is parked on a single counter instead of waiting on each task in turn.
+  // NOTE: `tasks` have to outlive the combined task
+  template <typename ...ResultTs>
+    Task<std::tuple<ResultTs...>> when_all(Task<ResultTs> &...tasks) {
+      return std::make_unique<detail::WhenAllTask<ResultTs...>>(*tasks...);
+    }
+
+  // Waits until any of already scheduled `tasks` completes and returns its index in the range.
+  // Throws `std::logic_error` if one of them is already waited on by another `when_all`/`when_any`.
+  // NOTE: `tasks` must not be empty
+  template <std::ranges::forward_range R>
+    size_t when_any(R &&tasks) {
+      auto count = static_cast<size_t>(std::ranges::distance(tasks));
+      detail::CompletionListener listener {count};
+
+      detail::listen_all(listener, tasks);
+      auto &executor = Executor::get();
+      executor.help_until([&listener] {
+        return listener.first.load(std::memory_order_acquire) != detail::CompletionListener::none;
+      });
+
+      // tasks which already took the listener will still arrive, it has to outlive them
+      size_t detached = 0;
+      for (auto &task : tasks) {
+        detached += detail::as_task_state(task).unlisten(listener);
+      }
+      executor.help_until([&listener, detached] {
+        return listener.remaining.load(std::memory_order_acquire) == detached;
+      });
+
+      return listener.first.load(std::memory_order_acquire);
+    }
+}
@@ -1,5 +1,12 @@
 #include <gtest/gtest.h>
 
+#include <any>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <numeric>
+#include <random>
+
 #include <mr-contractor/contractor.hpp>
 
 using namespace std::literals;
@@ -40,6 +47,32 @@ TEST(ParallelTest, MultipleStage) {
 }
 
 
+TEST(ParallelTest, OutputPadding) {
+  struct ThrowingMove {
+    int value = 0;
+
+    ThrowingMove(int value = 0) : value(value) {}
+    ThrowingMove(ThrowingMove &&) noexcept = default;
+    ThrowingMove & operator=(ThrowingMove &&other) { value = other.value; return *this; }
+  };
+  using Big = std::array<char, 2 * mr::cache_line_size>;
+
+  // gathering padded outputs must not throw, outputs which are not padded need no slots
+  static_assert(mr::detail::pad_output<int>);
+  static_assert(not mr::detail::pad_output<ThrowingMove>);
+  static_assert(not mr::detail::output_slots<std::tuple<Big, ThrowingMove>>::any);
+  static_assert(mr::detail::output_slots<std::tuple<Big, int>>::any);
+
+  auto par = Parallel {
+    [](int x) { Big big {}; big[0] = static_cast<char>(x); return big; },
+    [](int x) { return ThrowingMove {x}; }
+  };
+  auto task = mr::apply(par, {1, 2});
+  auto [big, value] = task->execute().result();
+  EXPECT_EQ(big[0], 1);
+  EXPECT_EQ(value.value, 2);
+}
+
 TEST(CompositeTest, SequenceOfParallels) {
   auto com = Sequence {
     Parallel {add_one, multiply_by_two},
@@ -143,4 +176,1388 @@ TEST(ReferenceTest, Parallel) {
 
   auto res = mr::apply(external_seq, std::make_tuple(0, 0))->execute().result();
   EXPECT_EQ(res, 0 + 102 + 0 + 47);
-}
\ No newline at end of file
+}
+
+TEST(ReentrantTest, ConcurrentExecutions) {
+  auto prototype = mr::Sequence {add_one, multiply_by_two};
+  auto reentrant = mr::apply_reentrant(prototype, 4);
+
+  std::vector<std::thread> clients;
+  std::atomic<int> mismatches = 0;
+  for (int t = 0; t < 4; t++) {
+    clients.emplace_back([&, t] {
+      for (int i = 0; i < 64; i++) {
+        int input = t * 1000 + i;
+        auto execution = reentrant.execute(input);
+        if (execution.result() != (input + 1) * 2) {
+          mismatches++;
+        }
+      }
+    });
+  }
+  for (auto &client : clients) {
+    client.join();
+  }
+
+  EXPECT_EQ(mismatches, 0);
+}
+
+TEST(ReentrantTest, ExhaustedRing) {
+  std::atomic<bool> gate = false;
+  auto prototype = mr::Sequence {
+    [&gate](int x) -> int {
+      gate.wait(false);
+      return x + 1;
+    }
+  };
+  auto reentrant = mr::apply_reentrant(prototype, 1);
+
+  auto first = reentrant.schedule(1);
+  EXPECT_FALSE(reentrant.try_schedule(2).has_value());
+
+  gate = true;
+  gate.notify_all();
+  EXPECT_EQ(first.wait().result(), 2);
+  first = {};
+
+  auto second = reentrant.try_schedule(2);
+  ASSERT_TRUE(second.has_value());
+  EXPECT_EQ(second->wait().result(), 3);
+}
+
+TEST(ReentrantTest, NonDefaultConstructibleInput) {
+  struct Input {
+    explicit Input(int value) : value(value) {}
+    int value;
+  };
+  auto prototype = mr::Sequence {[](Input input) { return input.value + 1; }};
+  auto reentrant = mr::apply_reentrant(prototype, 2);
+
+  // result waits for the execution by itself
+  auto execution = reentrant.schedule(Input(1));
+  EXPECT_EQ(execution.result(), 2);
+  EXPECT_EQ(reentrant.execute(Input(41)).result(), 42);
+}
+
+TEST(StreamTest, SerialKeepsOrder) {
+  auto prototype = mr::Sequence {add_one, multiply_by_two, to_string};
+  auto stream = mr::stream(prototype, {.capacity = 4});
+
+  std::jthread producer([&] {
+    for (int i = 0; i < 100; i++) {
+      stream.push(i);
+    }
+    stream.close();
+  });
+
+  int expected = 0;
+  while (auto result = stream.pop()) {
+    EXPECT_EQ(*result, std::to_string((expected + 1) * 2));
+    expected++;
+  }
+  EXPECT_EQ(expected, 100);
+}
+
+TEST(StreamTest, SerialIo) {
+  std::atomic<int> inside = 0, overlaps = 0;
+  auto prototype = mr::Sequence {
+    mr::Io {[&](int x) {
+      if (inside.fetch_add(1) != 0) {
+        overlaps++;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+      inside--;
+      return x;
+    }},
+    add_one
+  };
+  auto stream = mr::stream(prototype, {.capacity = 8});
+
+  std::jthread producer([&] {
+    for (int i = 0; i < 200; i++) {
+      stream.push(i);
+    }
+    stream.close();
+  });
+
+  // a serial I/O filter runs on the pool one item at a time, however often its worker is scheduled
+  int expected = 0;
+  while (auto result = stream.pop()) {
+    EXPECT_EQ(*result, expected + 1);
+    expected++;
+  }
+  EXPECT_EQ(expected, 200);
+  EXPECT_EQ(overlaps, 0);
+}
+
+TEST(StreamTest, ParallelFilter) {
+  auto prototype = mr::Sequence {add_one, multiply_by_two};
+  auto stream = mr::stream(prototype, {mr::FilterMode::parallel, mr::FilterMode::serial}, {.capacity = 8});
+
+  std::jthread producer([&] {
+    for (int i = 0; i < 1000; i++) {
+      stream.push(i);
+    }
+    stream.close();
+  });
+
+  int count = 0;
+  long long sum = 0;
+  while (auto result = stream.pop()) {
+    count++;
+    sum += *result;
+  }
+  EXPECT_EQ(count, 1000);
+  EXPECT_EQ(sum, 1000LL * 1001);
+}
+
+TEST(StreamTest, Shedding) {
+  std::atomic<bool> gate = false;
+  auto prototype = mr::Sequence {
+    [&gate](int x) -> int {
+      gate.wait(false);
+      return x;
+    }
+  };
+  auto stream = mr::stream(prototype, {.capacity = 2, .overflow = mr::Overflow::shed});
+
+  int accepted = 0;
+  for (int i = 0; i < 10; i++) {
+    accepted += stream.push(i);
+  }
+  EXPECT_LE(accepted, 3);
+
+  gate = true;
+  gate.notify_all();
+  stream.close();
+
+  int delivered = 0;
+  while (stream.pop()) {
+    delivered++;
+  }
+  EXPECT_EQ(delivered, accepted);
+}
+
+TEST(WhenTest, All) {
+  auto seq = mr::Sequence {add_one, to_string};
+  auto par = mr::Parallel {add_one, multiply_by_two};
+
+  auto seq_task = mr::apply(seq, 1);
+  auto par_task = mr::apply(par, {1, 2});
+
+  auto all = mr::when_all(seq_task, par_task);
+  auto [str, tuple] = all->execute().result();
+  EXPECT_EQ(str, "2"s);
+  EXPECT_EQ(tuple, std::tuple(2, 4));
+  EXPECT_TRUE(seq_task->is_ready());
+  EXPECT_TRUE(par_task->is_ready());
+}
+
+TEST(WhenTest, AllOfScheduled) {
+  auto seq = mr::Sequence {add_one};
+  auto first = mr::apply(seq, 1);
+  auto second = mr::apply(seq, 2);
+
+  first->schedule();
+  second->schedule();
+  auto all = mr::when_all(first, second);
+  EXPECT_EQ(all->wait().result(), std::tuple(2, 3));
+}
+
+TEST(WhenTest, Any) {
+  std::atomic<bool> gate = false;
+  auto slow = mr::Sequence {
+    [&gate](int x) -> int {
+      gate.wait(false);
+      return x;
+    }
+  };
+  auto fast = mr::Sequence {add_one};
+
+  std::vector<mr::Task<int>> tasks;
+  tasks.push_back(mr::apply(slow, 0));
+  tasks.push_back(mr::apply(fast, 0));
+  for (auto &task : tasks) {
+    task->schedule();
+  }
+
+  // NOTE: opened from another thread, the waiting one may be running the slow stage itself
+  std::jthread opener([&gate] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    gate = true;
+    gate.notify_all();
+  });
+
+  EXPECT_EQ(mr::when_any(tasks), 1);
+  EXPECT_EQ(tasks[1]->result(), 1);
+
+  tasks[0]->wait();
+  EXPECT_EQ(mr::when_any(tasks), 0);
+}
+
+TEST(WhenTest, SecondListener) {
+  std::atomic<bool> gate = false;
+  auto slow = mr::Sequence {
+    [&gate](int x) -> int {
+      gate.wait(false);
+      return x;
+    }
+  };
+  auto fast = mr::Sequence {add_one};
+
+  std::vector<mr::Task<int>> tasks;
+  tasks.push_back(mr::apply(fast, 1));
+  tasks.push_back(mr::apply(slow, 0));
+  auto all = mr::when_all(tasks[0], tasks[1]);
+  all->schedule();
+
+  std::jthread opener([&gate] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    gate = true;
+    gate.notify_all();
+  });
+  // the slow task is already waited on by `all`
+  EXPECT_THROW(mr::when_any(tasks), std::logic_error);
+  EXPECT_EQ(all->wait().result(), std::tuple(2, 0));
+}
+
+// tasks keep arriving after `when_any` returned, its listener must outlive them
+TEST(WhenTest, AnyManyRounds) {
+  auto &executor = mr::Executor::get();
+  executor.thread_count(4);
+
+  auto prototype = mr::Sequence {add_one};
+  std::vector<mr::Task<int>> tasks;
+  for (int i = 0; i < 4; i++) {
+    tasks.push_back(mr::apply(prototype, i));
+  }
+  for (int round = 0; round < 500; round++) {
+    for (auto &task : tasks) {
+      task->schedule();
+    }
+    auto index = mr::when_any(tasks);
+    EXPECT_EQ(tasks[index]->result(), static_cast<int>(index) + 1);
+    for (auto &task : tasks) {
+      task->wait();
+    }
+  }
+
+  executor.thread_count(mr::Executor::threadcount);
+}
+
+TEST(ExecutorTest, Elastic) {
+  using namespace std::chrono_literals;
+  auto &executor = mr::Executor::get();
+  executor.elastic({.min_threads = 1, .max_threads = 4, .idle_timeout = 1ms, .spawn_interval = 0us});
+
+  auto wait_for = [](auto predicate) {
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (not predicate() && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(1ms);
+    }
+    return predicate();
+  };
+  EXPECT_TRUE(wait_for([&] { return executor.thread_count() == 1; }));
+
+  // every branch waits until all of them run at once, which needs the pool to grow
+  std::atomic<int> running = 0;
+  auto branch = [&running](int x) -> int {
+    running++;
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (running.load() < 4 && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::yield();
+    }
+    return x;
+  };
+  auto par = mr::Parallel {branch, branch, branch, branch};
+  mr::apply(par, {0, 1, 2, 3})->execute();
+  EXPECT_EQ(running.load(), 4);
+  // NOTE: the waiting thread helps, so it may run one of the branches itself
+  EXPECT_GE(executor.thread_count(), 3);
+
+  EXPECT_TRUE(wait_for([&] { return executor.thread_count() == 1; }));
+
+  executor.thread_count(mr::Executor::threadcount);
+  EXPECT_EQ(executor.thread_count(), mr::Executor::threadcount);
+}
+
+TEST(ExecutorTest, HelpWhileWaiting) {
+  auto prototype = mr::Sequence {
+    [](int x) -> std::tuple<int, int> { return {x, 2*x}; },
+    mr::Parallel {
+      mr::Sequence {
+        [](int a) -> float { return a * 2; },
+        [](float b) -> double { return b / 3.0; }
+      },
+      mr::Sequence {
+        [](int b) -> int { return b + 5; },
+        [](int c) -> float { return c * 1.5f; }
+      }
+    },
+    [](std::tuple<double, float> y) -> int { return std::get<0>(y) + std::get<1>(y); }
+  };
+
+  auto &executor = mr::Executor::get();
+  // nested tasks wait inside a worker, which used to deadlock a single worker pool
+  for (int threads : {1, 0}) {
+    executor.thread_count(threads);
+    EXPECT_EQ(mr::apply(prototype, 47)->execute().result(), 179);
+  }
+  executor.thread_count(mr::Executor::threadcount);
+}
+
+TEST(ExecutorTest, WaitSleeps) {
+  auto &executor = mr::Executor::get();
+  executor.thread_count(0);
+
+  // the second stage is scheduled by an I/O thread while the waiting one sleeps, nobody else can run it
+  auto prototype = mr::Sequence {
+    mr::Io {[](int x) {
+      std::this_thread::sleep_for(100ms);
+      return x;
+    }},
+    add_one
+  };
+  auto task = mr::apply(prototype, 1);
+
+#ifdef __linux__
+  auto cpu_time = [] {
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+  };
+  auto before = cpu_time();
+#endif
+  EXPECT_EQ(task->execute().result(), 2);
+#ifdef __linux__
+  EXPECT_LT(cpu_time() - before, 50ms);
+#endif
+
+  executor.thread_count(mr::Executor::threadcount);
+}
+
+TEST(CostTest, CriticalPath) {
+  using namespace std::chrono_literals;
+  auto prototype = mr::Sequence {
+    mr::Estimated {[](int x) -> std::tuple<int, int> { return {x, x}; }, 1ms},
+    mr::Parallel {
+      mr::Estimated {add_one, 2ms},
+      mr::Sequence {
+        mr::Estimated {add_one, 3ms},
+        mr::Estimated {multiply_by_two, 4ms}
+      }
+    }
+  };
+  EXPECT_EQ(prototype.cost, 8ms);
+  EXPECT_EQ(mr::apply(prototype, 1)->execute().result(), std::tuple(2, 4));
+
+  auto par = mr::Parallel {mr::Estimated {add_one, 1ms}, mr::Estimated {add_one, 5ms}, add_one};
+  EXPECT_EQ(par.cost, 5ms);
+  EXPECT_EQ(par.cost_model->order(), (std::array<size_t, 3> {1, 0, 2}));
+}
+
+TEST(CostTest, LearnedOrder) {
+  auto par = mr::Parallel {
+    add_one,
+    [](int x) -> int {
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      return x;
+    }
+  };
+  EXPECT_EQ(par.cost_model->order(), (std::array<size_t, 2> {0, 1}));
+
+  // branches are measured on sampled runs only, the first one among them
+  auto task = mr::apply(par, {0, 0});
+  for (size_t i = 0; i < mr::detail::CostModel<2>::sample_interval; i++) {
+    task->execute();
+  }
+  EXPECT_EQ(par.cost_model->order(), (std::array<size_t, 2> {1, 0}));
+}
+
+TEST(ResultTest, Reference) {
+  auto seq = mr::Sequence {add_one, to_string};
+  auto task = mr::apply(seq, 1);
+  const std::string &ref = task->execute().result_ref();
+  EXPECT_EQ(ref, "2");
+
+  auto par = mr::Parallel {add_one, to_string};
+  auto par_task = mr::apply(par, {1, 2});
+  auto &[number, string] = par_task->execute().result_ref();
+  EXPECT_EQ(number, 2);
+  EXPECT_EQ(string, "2");
+}
+
+// `std::any` would take the in-place constructing helper itself as its value
+TEST(ResultTest, GreedyConstructor) {
+  auto seq = mr::Sequence {
+    [](std::any input) { return std::any(std::any_cast<int>(input) + 1); },
+    [](std::any input) { return std::any(std::any_cast<int>(input) * 2); }
+  };
+  auto task = mr::apply(seq, std::any(20));
+  EXPECT_EQ(std::any_cast<int>(task->execute().result()), 42);
+
+  std::optional<std::any> destination;
+  auto into = mr::apply_into(seq, std::any(1), destination);
+  into->execute();
+  EXPECT_EQ(std::any_cast<int>(*destination), 4);
+
+  mr::DynamicSequence<std::any, std::any> dynamic;
+  dynamic.push_back([](std::any input) { return std::any(std::any_cast<int>(input) + 1); });
+  EXPECT_EQ(std::any_cast<int>(mr::apply(dynamic, std::any(2))->execute().result()), 3);
+}
+
+TEST(ResultTest, Destination) {
+  // counts moves to check the result is not relocated after the last stage
+  struct Buffer {
+    std::vector<int> data;
+    int *moves;
+
+    Buffer(std::vector<int> data, int *moves) : data(std::move(data)), moves(moves) {}
+    Buffer(Buffer &&other) noexcept : data(std::move(other.data)), moves(other.moves) { ++*moves; }
+    Buffer & operator=(Buffer &&other) noexcept { data = std::move(other.data); moves = other.moves; ++*moves; return *this; }
+  };
+
+  int moves = 0;
+  auto seq = mr::Sequence {
+    [&moves](int x) -> Buffer { return Buffer(std::vector<int>(x, 7), &moves); }
+  };
+
+  std::optional<Buffer> destination;
+  auto task = mr::apply_into(seq, 3, destination);
+  task->execute();
+  ASSERT_TRUE(destination.has_value());
+  EXPECT_EQ(destination->data, std::vector<int>(3, 7));
+  EXPECT_EQ(moves, 0);
+  EXPECT_EQ(&task->result_ref(), &*destination);
+
+  auto par = mr::Parallel {add_one, multiply_by_two};
+  std::optional<std::tuple<int, int>> par_destination;
+  mr::apply_into(par, {1, 2}, par_destination)->execute();
+  EXPECT_EQ(par_destination, std::tuple(2, 4));
+}
+
+TEST(UnpackTest, MultiArgumentStage) {
+  auto prototype = mr::Sequence {
+    [](int x) -> std::tuple<int, int> { return {x, x * 2}; },
+    mr::Parallel {add_one, to_string},
+    [](int number, const std::string &string) -> std::string { return std::to_string(number) + "/" + string; }
+  };
+  EXPECT_EQ(mr::apply(prototype, 5)->execute().result(), "6/10");
+}
+
+TEST(UnpackTest, NoRelocation) {
+  // counts copies and moves of branch results on their way to the next stage
+  struct Tracked {
+    int *relocations;
+
+    Tracked(int *relocations) : relocations(relocations) {}
+    Tracked(const Tracked &other) : relocations(other.relocations) { ++*relocations; }
+    Tracked(Tracked &&other) noexcept : relocations(other.relocations) { ++*relocations; }
+    Tracked & operator=(const Tracked &other) = default;
+    Tracked & operator=(Tracked &&other) noexcept = default;
+  };
+
+  int relocations = 0;
+  auto prototype = mr::Sequence {
+    [](std::tuple<Tracked, Tracked> &&in) -> std::tuple<Tracked, Tracked> { return std::move(in); },
+    [](const Tracked &a, Tracked &&b) -> bool { return a.relocations == b.relocations; }
+  };
+
+  auto task = mr::apply(prototype, std::tuple<Tracked, Tracked> {&relocations, &relocations});
+  relocations = 0;
+  task->schedule();
+  task->wait();
+  EXPECT_TRUE(task->result());
+  // getter's copy of the initial value, first stage's return and storing its output, 2 elements each.
+  // the handoff to the second stage does not relocate anything
+  EXPECT_EQ(relocations, 6);
+}
+
+TEST(DynamicTest, Sequence) {
+  mr::DynamicSequence<int, std::string> seq;
+  for (int i = 0; i < 10; i++) {
+    seq.push_back(add_one);
+  }
+  seq.push_back(to_string);
+  EXPECT_THROW(seq.push_back(add_one), std::invalid_argument);
+
+  auto task = mr::apply(seq, 5);
+  EXPECT_EQ(task->execute().result(), "15");
+  EXPECT_EQ(task->execute().result(), "15");
+
+  mr::DynamicSequence<int, std::string> incomplete {add_one};
+  EXPECT_THROW(mr::apply(incomplete, 5), std::invalid_argument);
+}
+
+TEST(DynamicTest, Parallel) {
+  mr::DynamicParallel<int, int> par;
+  for (int i = 0; i < 16; i++) {
+    par.push_back([i](int x) { return x * i; });
+  }
+
+  auto task = mr::apply(par, std::vector<int>(16, 2));
+  auto result = task->execute().result();
+  ASSERT_EQ(result.size(), 16);
+  for (int i = 0; i < 16; i++) {
+    EXPECT_EQ(result[i], 2 * i);
+  }
+
+  // every branch takes an element of its own
+  auto short_input = mr::apply(par, std::vector<int>(15, 2));
+  EXPECT_THROW(short_input->schedule(), std::invalid_argument);
+
+  // outputs packed by `std::vector<bool>` are not written by several branches at once
+  mr::DynamicParallel<int, bool> odd;
+  for (int i = 0; i < 64; i++) {
+    odd.push_back([i](int x) { return (x + i) % 2 == 1; });
+  }
+  auto odd_task = mr::apply(odd, std::vector<int>(64, 1));
+  for (int run = 0; run < 20; run++) {
+    auto flags = odd_task->execute().result();
+    ASSERT_EQ(flags.size(), 64);
+    for (int i = 0; i < 64; i++) {
+      EXPECT_EQ(flags[i], i % 2 == 0);
+    }
+  }
+}
+
+TEST(DynamicTest, NestedInStatic) {
+  auto prototype = mr::Sequence {
+    [](int x) -> std::vector<int> { return {x, x + 1, x + 2}; },
+    mr::DynamicParallel<int, int> {add_one, multiply_by_two, add_one},
+    [](std::vector<int> v) -> int { return v[0] + v[1] + v[2]; },
+    mr::DynamicSequence<int, std::string> {multiply_by_two, to_string}
+  };
+  EXPECT_EQ(mr::apply(prototype, 1)->execute().result(), "20");
+}
+
+TEST(MetaTest, TypeComputations) {
+  static_assert(std::is_same_v<mr::to_variant_t<int, float, int, double, float>, std::variant<int, float, double>>);
+  static_assert(std::is_same_v<mr::at_t<2, int, float, double>, double>);
+
+  using SeqT = decltype(mr::Sequence {add_one, to_string});
+  static_assert(std::is_same_v<SeqT::VariantT, std::variant<int, std::string>>);
+
+  constexpr mr::detail::flat_tuple<int, char, int> tuple {1, 'a', 3};
+  static_assert(mr::detail::get<0>(tuple) == 1 && mr::detail::get<1>(tuple) == 'a' && mr::detail::get<2>(tuple) == 3);
+  SUCCEED();
+}
+
+TEST(PeriodicTest, Timer) {
+  using namespace std::chrono_literals;
+  std::atomic<int> results = 0;
+  auto seq = mr::Sequence {add_one, multiply_by_two};
+  auto task = mr::apply(seq, 1);
+
+  {
+    mr::Periodic periodic(task, 2ms, [&results](int &result) {
+      if (result == 4) {
+        results++;
+      }
+    });
+    std::this_thread::sleep_for(50ms);
+    periodic.stop();
+
+    auto stats = periodic.stats();
+    EXPECT_GT(stats.runs, 5);
+    EXPECT_EQ(results.load(), stats.runs);
+    EXPECT_GE(stats.jitter_max, stats.jitter_mean);
+  }
+}
+
+TEST(PeriodicTest, Overrun) {
+  using namespace std::chrono_literals;
+  auto seq = mr::Sequence {
+    [](int x) -> int {
+      std::this_thread::sleep_for(5ms);
+      return x;
+    }
+  };
+  auto task = mr::apply(seq, 1);
+
+  mr::Periodic periodic(task, 1ms);
+  std::this_thread::sleep_for(30ms);
+  periodic.stop();
+  EXPECT_GT(periodic.stats().overruns, 0);
+}
+
+TEST(PeriodicTest, Signal) {
+  std::atomic<bool> gate = false;
+  int sum = 0;
+  auto seq = mr::Sequence {
+    [&gate](int x) -> int {
+      gate.wait(false);
+      return x;
+    }
+  };
+  auto task = mr::apply(seq, 3);
+
+  mr::Periodic periodic(task, [&sum](int &result) { sum += result; });
+  EXPECT_TRUE(periodic.signal());
+  EXPECT_FALSE(periodic.signal());
+
+  std::jthread opener([&gate] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    gate = true;
+    gate.notify_all();
+  });
+  periodic.wait();
+  EXPECT_TRUE(periodic.signal());
+  periodic.wait();
+
+  EXPECT_EQ(sum, 6);
+  EXPECT_EQ(periodic.stats().runs, 2);
+  EXPECT_EQ(periodic.stats().overruns, 1);
+  // jitter is only measured against ticks of the timer
+  EXPECT_EQ(periodic.stats().jitter_max, 0ns);
+}
+
+TEST(DeadlineTest, EarliestFirst) {
+  using namespace std::chrono_literals;
+  auto &executor = mr::Executor::get();
+  executor.thread_count(0);
+  // NOTE: retired workers may finish their current attempt, none may run a contract of this test
+  while (executor.live_threads() != 0) {
+    std::this_thread::yield();
+  }
+
+  std::vector<int> order;
+  auto seq = mr::Sequence {
+    [&order](int x) -> int {
+      order.push_back(x);
+      return x;
+    }
+  };
+
+  auto now = mr::Deadline::Clock::now();
+  auto late = mr::apply(seq, 3, mr::Deadline {now + 3s});
+  auto fifo = mr::apply(seq, 4);
+  auto mid = mr::apply(seq, 2, mr::Deadline {now + 2s});
+  auto early = mr::apply(seq, 1, mr::Deadline {now + 1s});
+  late->schedule();
+  fifo->schedule();
+  mid->schedule();
+  early->schedule();
+  while (executor.execute_next()) {}
+
+  executor.thread_count(mr::Executor::threadcount);
+  EXPECT_EQ(order, (std::vector<int> {1, 2, 3, 4}));
+}
+
+TEST(DeadlineTest, Inherited) {
+  using namespace std::chrono_literals;
+  auto deadline = mr::Deadline {mr::Deadline::Clock::now() + 1s};
+
+  std::atomic<bool> inherited = false;
+  auto inner = mr::Sequence {
+    [&](int x) -> int {
+      inherited = mr::Executor::current_deadline().at == deadline.at;
+      return x;
+    }
+  };
+  auto outer = mr::Sequence {add_one, std::ref(inner)};
+
+  EXPECT_EQ(mr::apply(outer, 1, deadline)->execute().result(), 2);
+  EXPECT_TRUE(inherited);
+}
+
+TEST(DeadlineTest, DropMissed) {
+  std::atomic<int> runs = 0;
+  auto seq = mr::Sequence {
+    [&runs](int x) -> int {
+      runs++;
+      return x;
+    },
+    add_one
+  };
+
+  auto past = mr::Deadline {mr::Deadline::Clock::now() - std::chrono::milliseconds(1), true};
+  auto task = mr::apply(seq, 1, past);
+  task->execute();
+  EXPECT_TRUE(task->missed());
+  EXPECT_EQ(runs.load(), 0);
+
+  task->set_deadline({});
+  EXPECT_EQ(task->execute().result(), 2);
+  EXPECT_FALSE(task->missed());
+}
+
+TEST(IncrementalTest, SkipsUnchangedBranches) {
+  std::array<std::atomic<int>, 2> runs {};
+  auto par = mr::Parallel {
+    [&runs](int x) -> int { runs[0]++; return x + 1; },
+    [&runs](std::string s) -> std::string { runs[1]++; return s + "!"; }
+  };
+
+  std::tuple<int, std::string> input {1, "a"};
+  auto task = mr::apply_incremental(par, [&input] { return input; });
+
+  EXPECT_EQ(task->execute().result_ref(), std::tuple(2, "a!"s));
+  EXPECT_EQ(task->execute().result_ref(), std::tuple(2, "a!"s));
+  EXPECT_EQ(runs[0].load(), 1);
+  EXPECT_EQ(runs[1].load(), 1);
+
+  std::get<1>(input) = "b";
+  EXPECT_EQ(task->execute().result_ref(), std::tuple(2, "b!"s));
+  EXPECT_EQ(runs[0].load(), 1);
+  EXPECT_EQ(runs[1].load(), 2);
+
+  // moved out outputs are computed again
+  EXPECT_EQ(task->result(), std::tuple(2, "b!"s));
+  EXPECT_EQ(task->execute().result_ref(), std::tuple(2, "b!"s));
+  EXPECT_EQ(runs[0].load(), 2);
+  EXPECT_EQ(runs[1].load(), 3);
+}
+
+TEST(IncrementalTest, Version) {
+  // compared by the stamp only, the payload itself is not even comparable
+  struct Mesh {
+    std::vector<int> vertices;
+    int stamp;
+
+    int version() const { return stamp; }
+  };
+
+  std::atomic<int> runs = 0;
+  auto par = mr::Parallel {
+    [&runs](Mesh mesh) -> size_t { runs++; return mesh.vertices.size(); },
+    add_one
+  };
+
+  std::tuple<Mesh, int> input {Mesh {{1, 2, 3}, 0}, 0};
+  auto task = mr::apply_incremental(par, [&input] { return input; });
+  task->execute();
+  std::get<0>(input).vertices.push_back(4); // same version, considered unchanged
+  EXPECT_EQ(task->execute().result_ref(), std::tuple(size_t(3), 1));
+  EXPECT_EQ(runs.load(), 1);
+
+  std::get<0>(input).stamp++;
+  EXPECT_EQ(task->execute().result_ref(), std::tuple(size_t(4), 1));
+  EXPECT_EQ(runs.load(), 2);
+}
+
+TEST(IncrementalTest, Nested) {
+  std::array<std::atomic<int>, 3> runs {};
+  auto prototype = mr::Sequence {
+    [](int x) -> std::tuple<std::tuple<int, int>, int> { return {{x / 100, x / 10 % 10}, x % 10}; },
+    mr::Parallel {
+      mr::Parallel {
+        [&runs](int x) -> int { runs[0]++; return x; },
+        [&runs](int x) -> int { runs[1]++; return x; }
+      },
+      [&runs](int x) -> int { runs[2]++; return x; }
+    },
+    [](const std::tuple<int, int> &hundreds_tens, int ones) -> int {
+      return std::get<0>(hundreds_tens) * 100 + std::get<1>(hundreds_tens) * 10 + ones;
+    }
+  };
+
+  int input = 123;
+  auto task = mr::apply_incremental(prototype, [&input] { return input; });
+  EXPECT_EQ(task->execute().result_ref(), 123);
+
+  input = 124;
+  EXPECT_EQ(task->execute().result_ref(), 124);
+  EXPECT_EQ(runs[0].load(), 1);
+  EXPECT_EQ(runs[1].load(), 1);
+  EXPECT_EQ(runs[2].load(), 2);
+
+  // only one branch of the nested Parallel runs again
+  input = 134;
+  EXPECT_EQ(task->execute().result_ref(), 134);
+  EXPECT_EQ(runs[0].load(), 1);
+  EXPECT_EQ(runs[1].load(), 2);
+  EXPECT_EQ(runs[2].load(), 2);
+}
+
+TEST(ContractTest, SlotReuse) {
+  auto prototype = mr::Sequence {
+    add_one,
+    [](int x) -> std::tuple<int, int> { return {x, x}; },
+    mr::Parallel {add_one, multiply_by_two}
+  };
+  auto &executor = mr::Executor::get();
+  auto before = executor.contract_usage();
+
+  {
+    // slots are taken by the first schedule, not by apply
+    auto task = mr::apply(prototype, 1);
+    EXPECT_EQ(executor.contract_usage().used, before.used);
+    EXPECT_EQ(task->execute().result(), std::tuple(3, 4));
+    EXPECT_GT(executor.contract_usage().used, before.used);
+  }
+  // NOTE: a slot whose run is still finishing is recycled by that run
+  while (executor.contract_usage().used != before.used) {
+    std::this_thread::yield();
+  }
+
+  // short-lived tasks and their nested tasks recycle the same slots
+  auto capacity = executor.contract_usage().capacity;
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(mr::apply(prototype, i)->execute().result(), std::tuple(i + 2, (i + 1) * 2));
+  }
+  EXPECT_EQ(executor.contract_usage().capacity, capacity);
+}
+
+TEST(ContractTest, DestroyedWhileScheduled) {
+  auto &executor = mr::Executor::get();
+  executor.thread_count(0);
+  executor.run_pending();
+  auto before = executor.contract_usage();
+
+  int first = 0, second = 0;
+  {
+    auto contract = executor.create_contract([&first] { first++; });
+    contract.schedule();
+  }
+  // the slot of the destroyed contract is not bound again while its run is pending
+  EXPECT_EQ(executor.contract_usage().used, before.used + 1);
+  auto contract = executor.create_contract([&second] { second++; });
+  contract.schedule();
+  EXPECT_EQ(executor.contract_usage().used, before.used + 2);
+
+  executor.run_pending();
+  EXPECT_EQ(first, 0);
+  EXPECT_EQ(second, 1);
+  EXPECT_EQ(executor.contract_usage().used, before.used + 1);
+
+  executor.thread_count(mr::Executor::threadcount);
+}
+
+TEST(BackendTest, Inline) {
+  auto prototype = mr::Sequence {
+    [](int x) -> std::tuple<int, int> { return {x, x}; },
+    mr::Parallel {
+      [](int x) -> std::thread::id { return std::this_thread::get_id(); },
+      add_one
+    }
+  };
+  auto task = mr::apply(prototype, 1);
+
+  mr::Executor::get().backend(mr::InlineBackend {});
+  task->schedule();
+  EXPECT_TRUE(task->is_ready());
+  EXPECT_EQ(task->result(), std::tuple(std::this_thread::get_id(), 2));
+  mr::Executor::get().default_backend();
+
+  EXPECT_EQ(std::get<1>(task->execute().result()), 2);
+}
+
+TEST(BackendTest, Pool) {
+  // stand-in for an external pool, a thread per posted contract
+  std::mutex mutex;
+  std::vector<std::jthread> threads;
+  mr::Executor::get().backend(mr::PoolBackend {
+    [&](auto run) {
+      std::lock_guard lock(mutex);
+      threads.emplace_back(std::move(run));
+    }
+  });
+
+  auto prototype = mr::Sequence {
+    [](int x) -> std::tuple<int, int> { return {x, x}; },
+    mr::Parallel {add_one, multiply_by_two}
+  };
+  EXPECT_EQ(mr::apply(prototype, 3)->execute().result(), std::tuple(4, 6));
+  mr::Executor::get().default_backend();
+
+  std::lock_guard lock(mutex);
+  EXPECT_EQ(threads.size(), 4);
+}
+
+TEST(BackendTest, MergedSchedules) {
+  auto &executor = mr::Executor::get();
+  std::vector<std::function<void(void)>> jobs;
+  executor.backend(mr::PoolBackend {[&jobs](auto run) { jobs.push_back(std::move(run)); }});
+
+  int runs = 0;
+  mr::Contract contract;
+  contract = executor.create_contract([&] {
+    // absorbed while it runs, it is submitted once more after it returns
+    if (++runs == 1) {
+      contract.schedule();
+      contract.schedule();
+    }
+  });
+  contract.schedule();
+  contract.schedule();
+  ASSERT_EQ(jobs.size(), 1);
+  jobs[0]();
+  ASSERT_EQ(jobs.size(), 2);
+  jobs[1]();
+  EXPECT_EQ(runs, 2);
+  EXPECT_EQ(jobs.size(), 2);
+
+  // a contract rescheduling itself runs in a loop instead of recursion
+  executor.backend(mr::InlineBackend {});
+  int left = 1'000'000;
+  mr::Contract loop;
+  loop = executor.create_contract([&] {
+    if (--left > 0) {
+      loop.schedule();
+    }
+  });
+  loop.schedule();
+  EXPECT_EQ(left, 0);
+  executor.default_backend();
+}
+
+TEST(BroadcastTest, SharedInput) {
+  struct Big {
+    std::vector<int> data;
+    int *copies;
+
+    Big(std::vector<int> data, int *copies) : data(std::move(data)), copies(copies) {}
+    Big(const Big &other) : data(other.data), copies(other.copies) { ++*copies; }
+    Big(Big &&) noexcept = default;
+    Big & operator=(const Big &other) { data = other.data; copies = other.copies; ++*copies; return *this; }
+    Big & operator=(Big &&) noexcept = default;
+  };
+
+  int copies = 0;
+  auto prototype = mr::Sequence {
+    [&copies](int n) -> Big { return Big(std::vector<int>(n, 1), &copies); },
+    mr::Broadcast {
+      [](const Big &big) -> size_t { return big.data.size(); },
+      [](const Big &big) -> int { return std::accumulate(big.data.begin(), big.data.end(), 0); },
+      mr::Estimated {[](const Big &big) -> bool { return big.data.empty(); }, std::chrono::milliseconds(1)}
+    }
+  };
+
+  EXPECT_EQ(mr::apply(prototype, 1000)->execute().result(), std::tuple(size_t(1000), 1000, false));
+  EXPECT_EQ(copies, 0);
+}
+
+TEST(BroadcastTest, Incremental) {
+  struct Big {
+    std::vector<int> data;
+    int *copies;
+
+    Big(std::vector<int> data, int *copies) : data(std::move(data)), copies(copies) {}
+    Big(const Big &other) : data(other.data), copies(other.copies) { ++*copies; }
+    Big(Big &&) noexcept = default;
+    Big & operator=(const Big &other) { data = other.data; copies = other.copies; ++*copies; return *this; }
+    Big & operator=(Big &&) noexcept = default;
+
+    bool operator==(const Big &other) const { return data == other.data; }
+  };
+
+  int copies = 0;
+  std::atomic<int> runs = 0;
+  auto prototype = mr::Sequence {
+    [&copies](int n) -> Big { return Big(std::vector<int>(n, 1), &copies); },
+    mr::Broadcast {
+      [&runs](const Big &big) -> size_t { runs++; return big.data.size(); },
+      [&runs](const Big &big) -> int { runs++; return std::accumulate(big.data.begin(), big.data.end(), 0); },
+      [&runs](const Big &big) -> bool { runs++; return big.data.empty(); }
+    }
+  };
+
+  int input = 1000;
+  auto task = mr::apply_incremental(prototype, [&input] { return input; });
+  EXPECT_EQ(task->execute().result_ref(), std::tuple(size_t(1000), 1000, false));
+  EXPECT_EQ(task->execute().result_ref(), std::tuple(size_t(1000), 1000, false));
+  EXPECT_EQ(runs.load(), 3);
+  input = 10;
+  EXPECT_EQ(task->execute().result_ref(), std::tuple(size_t(10), 10, false));
+  EXPECT_EQ(runs.load(), 6);
+  // the shared input is remembered once per change, not once per branch
+  EXPECT_EQ(copies, 2);
+}
+
+TEST(BroadcastTest, Branches) {
+  auto pair = mr::Broadcast {
+    [](int a, int b) -> int { return a + b; },                                      // elements of the shared tuple
+    [](const std::tuple<int, int> &t) -> int { return std::get<0>(t) * std::get<1>(t); },
+    [](std::tuple<int, int> t) -> int { return std::get<0>(t) - std::get<1>(t); }, // a copy of its own
+    mr::Sequence {[](std::tuple<int, int> t) -> int { return std::get<1>(t); }, add_one}
+  };
+  EXPECT_EQ(mr::apply(pair, {3, 4})->execute().result(), std::tuple(7, 12, -1, 5));
+}
+
+TEST(AlgorithmTest, Reduce) {
+  std::vector<int> input(10'000);
+  std::iota(input.begin(), input.end(), 0);
+
+  EXPECT_EQ(mr::Reduce<int> {.grain = 100}(input), 49'995'000);
+  EXPECT_EQ((mr::Reduce {1, std::multiplies<>{}, 3})(std::vector<int>(10, 2)), 1024);
+  EXPECT_EQ(mr::Reduce<int> {.init = 7}({}), 7);
+
+  // nested into a pipeline
+  auto prototype = mr::Sequence {
+    [](int n) -> std::vector<int> { return std::vector<int>(n, 1); },
+    mr::Broadcast {mr::Reduce<int> {.grain = 64}, mr::Reduce<int> {.init = -1, .grain = 1000}}
+  };
+  EXPECT_EQ(mr::apply(prototype, 5000)->execute().result(), std::tuple(5000, 4999));
+}
+
+TEST(AlgorithmTest, Scan) {
+  std::vector<int> input(1001, 1);
+  auto res = mr::Scan<int> {.grain = 10}(input);
+  std::vector<int> expected(1001);
+  std::iota(expected.begin(), expected.end(), 1);
+  EXPECT_EQ(res, expected);
+
+  EXPECT_EQ((mr::Scan<std::string> {.grain = 2})({"a", "b", "c", "d", "e"}), (std::vector<std::string> {"a", "ab", "abc", "abcd", "abcde"}));
+  EXPECT_TRUE(mr::Scan<int> {}({}).empty());
+}
+
+TEST(AlgorithmTest, Sort) {
+  std::vector<int> input(10'007);
+  std::mt19937 rng(47);
+  std::generate(input.begin(), input.end(), rng);
+  auto expected = input;
+  std::sort(expected.begin(), expected.end());
+
+  EXPECT_EQ(mr::Sort<int> {.grain = 100}(input), expected);
+  std::reverse(expected.begin(), expected.end());
+  EXPECT_EQ((mr::Sort<int, std::greater<>> {.grain = 1000})(input), expected);
+
+  auto prototype = mr::Sequence {mr::Sort<int> {.grain = 512}, mr::Reduce<int> {}};
+  EXPECT_EQ(mr::apply(prototype, input)->execute().result(), std::accumulate(input.begin(), input.end(), 0));
+}
+
+TEST(IoTest, Routing) {
+  EXPECT_FALSE(mr::IoPool::is_io_thread());
+
+  auto prototype = mr::Sequence {
+    mr::Io {[](int x) { return std::pair(x, mr::IoPool::is_io_thread()); }},
+    [](std::pair<int, bool> read) { return std::tuple(read.first, std::pair(read.second, mr::IoPool::is_io_thread())); },
+    mr::Parallel {
+      mr::Io {[](int x) { return x + mr::IoPool::is_io_thread(); }},
+      [](std::pair<bool, bool> flags) { return flags; }
+    }
+  };
+  auto task = mr::apply(prototype, 1);
+  // the I/O stage ran on the pool, the stage after it on the executor again
+  EXPECT_EQ(task->execute().result(), std::tuple(2, std::pair(true, false)));
+
+  // branches of a `DynamicParallel` are routed one by one
+  auto dynamic = mr::DynamicParallel<int, bool> {
+    mr::Io {[](int) { return mr::IoPool::is_io_thread(); }},
+    [](int) { return mr::IoPool::is_io_thread(); }
+  };
+  EXPECT_EQ(mr::apply(dynamic, std::vector {0, 0})->execute().result(), (std::vector {true, false}));
+}
+
+TEST(IoTest, MappedFile) {
+  auto path = std::filesystem::temp_directory_path() / "mr-contractor-mapped-file-test";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "mapped";
+  }
+
+  auto prototype = mr::Sequence {
+    mr::map_file,
+    [](mr::MappedFile file) {
+      auto bytes = file.bytes();
+      return std::string(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    }
+  };
+  EXPECT_EQ(mr::apply(prototype, path)->execute().result(), "mapped");
+
+  std::ofstream(path, std::ios::trunc).close();
+  EXPECT_TRUE(mr::MappedFile(path).empty());
+  std::filesystem::remove(path);
+
+  EXPECT_THROW(mr::MappedFile {path}, std::system_error);
+}
+
+TEST(StaticTaskTest, Basic) {
+  auto seq = Sequence {add_one, multiply_by_two, to_string};
+  auto task = mr::apply_static(seq, 5);
+  EXPECT_EQ(task->execute().result(), "12");
+  EXPECT_TRUE(task.is_ready());
+
+  auto par = Parallel {add_one, std::ref(seq)};
+  mr::StaticTask par_task {par, std::tuple(1, 2)};
+  EXPECT_EQ(par_task.execute().result_ref(), std::tuple(2, "6"));
+  EXPECT_EQ(par_task.execute().result(), std::tuple(2, "6"));
+
+  int input = 0;
+  auto getter_task = mr::apply_static(seq, [&input]() { return input; });
+  input = 10;
+  EXPECT_EQ(getter_task->execute().result(), "22");
+}
+
+// fills a range recursively, halves are spawned into the group
+struct ParallelFill {
+  int *data;
+  size_t size;
+  size_t offset = 0;
+
+  void operator()(mr::TaskGroup &group) const {
+    if (size <= 64) {
+      for (size_t i = 0; i < size; i++) {
+        data[i] = static_cast<int>(offset + i);
+      }
+      return;
+    }
+    auto half = size / 2;
+    group.spawn(ParallelFill {data, half, offset});
+    group.spawn(ParallelFill {data + half, size - half, offset + half});
+  }
+};
+
+TEST(TaskGroupTest, SpawnFromStage) {
+  auto prototype = mr::Sequence {
+    [](int n) {
+      std::vector<int> res(n);
+      // the stage returns right away, the next one is scheduled once the children finished
+      mr::TaskGroup::current().spawn(ParallelFill {res.data(), res.size()});
+      return res;
+    },
+    [](std::vector<int> v) { return std::accumulate(v.begin(), v.end(), 0); }
+  };
+  auto task = mr::apply(prototype, 10'000);
+  EXPECT_EQ(task->execute().result(), 49'995'000);
+  EXPECT_EQ(task->execute().result(), 49'995'000);
+
+  auto par = mr::Parallel {
+    [](int n) {
+      std::vector<int> res(n);
+      mr::TaskGroup::current().spawn(ParallelFill {res.data(), res.size()});
+      return res;
+    },
+    add_one
+  };
+  auto par_task = mr::apply(par, std::tuple(1000, 1));
+  auto [filled, two] = par_task->execute().result();
+  EXPECT_EQ(std::accumulate(filled.begin(), filled.end(), 0), 499'500);
+  EXPECT_EQ(two, 2);
+}
+
+TEST(TaskGroupTest, Wait) {
+  std::atomic<int> count = 0;
+  {
+    mr::TaskGroup group;
+    for (int i = 0; i < 100; i++) {
+      group.spawn([&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+    }
+    group.wait();
+    EXPECT_EQ(count.load(), 100);
+    EXPECT_TRUE(group.done());
+  }
+
+  EXPECT_THROW(mr::TaskGroup::current(), std::logic_error);
+}
+
+TEST(TaskGroupTest, ChildrenShareRunners) {
+  auto &executor = mr::Executor::get();
+  executor.thread_count(0);
+  executor.run_pending();
+  auto before = executor.contract_usage();
+
+  int count = 0;
+  {
+    mr::TaskGroup group;
+    for (int i = 0; i < 1000; i++) {
+      group.spawn([&count, &group]() {
+        // nested children are queued into the same group
+        if (++count % 10 == 0) {
+          group.spawn([&count]() { count++; });
+        }
+      });
+    }
+    // a runner per worker (one without workers), not a contract per child
+    EXPECT_EQ(executor.contract_usage().used, before.used + 1);
+    group.wait();
+  }
+  EXPECT_EQ(count, 1100);
+  // the runner was scheduled again by the nested children, its dropped run recycles the slot
+  executor.run_pending();
+  EXPECT_EQ(executor.contract_usage().used, before.used);
+
+  // stages of dynamic prototypes have no group
+  std::string error;
+  auto prototype = mr::DynamicSequence<int, int> {[&error](int x) {
+    try {
+      mr::TaskGroup::current();
+    } catch (const std::logic_error &e) {
+      error = e.what();
+    }
+    return x;
+  }};
+  EXPECT_EQ(mr::apply(prototype, 1)->execute().result(), 1);
+  EXPECT_EQ(error, "mr::TaskGroup::current: not supported in dynamic prototypes");
+
+  executor.thread_count(mr::Executor::threadcount);
+}
+
+TEST(LimitedTest, MaxConcurrency) {
+  auto &executor = mr::Executor::get();
+  executor.thread_count(4);
+
+  std::atomic<int> running = 0;
+  std::atomic<int> peak = 0;
+  std::atomic<int> unlimited = 0;
+  auto limited = [&](int x) {
+    auto now = ++running;
+    for (auto seen = peak.load(); now > seen && not peak.compare_exchange_weak(seen, now);) {}
+    std::this_thread::sleep_for(2ms);
+    running--;
+    return x;
+  };
+
+  auto prototype = mr::Sequence {
+    [&](int x) { unlimited++; return x; },
+    mr::Limited {limited, 2},
+    add_one
+  };
+  std::vector<mr::Task<int>> tasks;
+  for (int i = 0; i < 16; i++) {
+    tasks.push_back(mr::apply(prototype, i));
+  }
+  for (auto &task : tasks) {
+    task->schedule();
+  }
+  int sum = 0;
+  for (auto &task : tasks) {
+    sum += task->wait().result();
+  }
+  EXPECT_EQ(sum, 136);
+  EXPECT_EQ(unlimited.load(), 16);
+  EXPECT_LE(peak.load(), 2);
+
+  // stages of one resource class share its limit
+  peak = 0;
+  auto db = mr::Resource::named("limited-test-db", 1);
+  EXPECT_EQ(mr::Resource::named("limited-test-db", 5).limit(), 1);
+  auto par = mr::Parallel {mr::Limited {limited, db}, mr::Estimated {mr::Limited {limited, db}, 1ms}};
+  auto par_task = mr::apply(par, std::tuple(1, 2));
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(par_task->execute().result(), std::tuple(1, 2));
+  }
+  EXPECT_EQ(peak.load(), 1);
+  EXPECT_EQ(db.active(), 0);
+
+  // branches of a `DynamicParallel` keep their resources as well
+  peak = 0;
+  mr::DynamicParallel<int, int> dynamic;
+  for (int i = 0; i < 8; i++) {
+    dynamic.push_back(mr::Limited {limited, db});
+  }
+  EXPECT_EQ(mr::apply(dynamic, std::vector<int>(8, 3))->execute().result(), std::vector<int>(8, 3));
+  EXPECT_EQ(peak.load(), 1);
+  EXPECT_EQ(db.deferred(), 0);
+
+  executor.thread_count(mr::Executor::threadcount);
+}
+
+TEST(LimitedTest, Stream) {
+  auto &executor = mr::Executor::get();
+  executor.thread_count(4);
+
+  std::atomic<int> running = 0, overlaps = 0;
+  auto resource = mr::Resource(2);
+  auto prototype = mr::Sequence {
+    mr::Limited {[&](int x) {
+      if (++running > 2) {
+        overlaps++;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(20));
+      running--;
+      return x;
+    }, resource},
+    add_one
+  };
+
+  {
+    // workers of the filter are scheduled on every push and pop, a permit is taken once per run
+    auto stream = mr::stream(prototype, {mr::FilterMode::parallel, mr::FilterMode::serial}, {.capacity = 8});
+    std::jthread producer([&] {
+      for (int i = 0; i < 500; i++) {
+        stream.push(i);
+      }
+      stream.close();
+    });
+
+    long long sum = 0;
+    while (auto result = stream.pop()) {
+      sum += *result;
+    }
+    EXPECT_EQ(sum, 500LL * 501 / 2);
+  }
+  EXPECT_EQ(overlaps, 0);
+
+  // dropped runs of the destroyed workers give their permits back as well
+  auto until = std::chrono::steady_clock::now() + 1s;
+  while ((resource.active() != 0 || resource.deferred() != 0) && std::chrono::steady_clock::now() < until) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(resource.active(), 0);
+  EXPECT_EQ(resource.deferred(), 0);
+
+  executor.thread_count(mr::Executor::threadcount);
+}
+
+TEST(ExecutorTest, Configure) {
+  auto &executor = mr::Executor::get();
+  executor.configure({.threads = 2, .idle_policy = mr::IdlePolicy::park});
+  EXPECT_EQ(executor.thread_count(), 2);
+
+  // parked workers are woken up by every schedule
+  auto prototype = mr::Sequence {
+    [](int x) { return std::tuple(x, x); },
+    mr::Parallel {multiply_by_two, to_string}
+  };
+  for (int i = 0; i < 100; i++) {
+    auto task = mr::apply(prototype, i);
+    EXPECT_EQ(task->execute().result(), std::tuple(2 * i, std::to_string(i)));
+    if (i % 10 == 0) {
+      std::this_thread::sleep_for(1ms); // lets the workers park
+    }
+  }
+
+  executor.configure({});
+  EXPECT_EQ(executor.thread_count(), mr::Executor::threadcount);
+
+  // CPUs the process can not run on are rejected before anything changes
+  EXPECT_THROW(executor.configure({.threads = 1, .affinity = {-1}}), std::invalid_argument);
+#if defined(__linux__) || defined(_WIN32)
+  EXPECT_THROW(executor.configure({.threads = 1, .affinity = {0, 1 << 20}}), std::invalid_argument);
+#endif
+  EXPECT_EQ(executor.thread_count(), mr::Executor::threadcount);
+  EXPECT_EQ(executor.pin_failures(), 0);
+}
+
+TEST(ExecutorTest, Pump) {
+  auto &executor = mr::Executor::get();
+  executor.configure({.threads = 0});
+  EXPECT_EQ(executor.thread_count(), 0);
+  std::this_thread::sleep_for(10ms); // lets retired workers leave
+
+  auto prototype = mr::Sequence {
+    [](int x) { return std::tuple(x, x); },
+    mr::Parallel {multiply_by_two, to_string}
+  };
+
+  // nothing runs until the calling thread pumps
+  auto task = mr::apply(prototype, 21);
+  task->schedule();
+  std::this_thread::sleep_for(1ms);
+  EXPECT_FALSE(task->is_ready());
+
+  // an exhausted budget still runs one contract
+  EXPECT_EQ(executor.run_pending(0us), 1);
+  EXPECT_FALSE(task->is_ready());
+  EXPECT_TRUE(executor.run_until(task));
+  EXPECT_EQ(task->result(), std::tuple(42, "21"s));
+
+  task->schedule();
+  EXPECT_GT(executor.run_pending(), 0);
+  EXPECT_TRUE(task->is_ready());
+  EXPECT_EQ(executor.run_pending(), 0);
+
+  // a task held by value is pumped the same way
+  mr::StaticTask static_task {prototype, 5};
+  static_task.schedule();
+  EXPECT_TRUE(executor.run_until(static_task));
+  EXPECT_EQ(static_task.result(), std::tuple(10, "5"s));
+
+  // waiting pumps as well
+  EXPECT_EQ(mr::apply(prototype, 1)->execute().result(), std::tuple(2, "1"s));
+
+  executor.configure({});
+  EXPECT_EQ(executor.thread_count(), mr::Executor::threadcount);
+}